@@ -52,6 +52,7 @@
 #include <QFileInfo>
 #include <QTextCodec>
 #include <QTextStream>
+#include <QThreadPool>
 #include <QVariant>
 
 static QString strip_template_args(const QString &name) {
@@ -140,7 +141,113 @@ QString rename_operator(const QString &oper) {
 }
 
 AbstractMetaBuilder::AbstractMetaBuilder()
-        : m_current_class(0) {
+        : m_current_class(0),
+          m_thread_count(1) {
+}
+
+static AbstractMetaClass *class_group_root(QHash<AbstractMetaClass *, AbstractMetaClass *> *parents,
+                                           AbstractMetaClass *cls) {
+    AbstractMetaClass *parent = parents->value(cls, cls);
+    if (parent == cls)
+        return cls;
+
+    AbstractMetaClass *root = class_group_root(parents, parent);
+    parents->insert(cls, root);
+    return root;
+}
+
+/**
+ * Splits the classes into groups that share no base class or
+ * interface. Fixing functions only reads and modifies classes in the
+ * hierarchy of the class being fixed, so the groups can be processed
+ * concurrently. Each group keeps the order of the input list, which
+ * makes the per-group work identical to a serial run.
+ */
+static QList<AbstractMetaClassList> independent_class_groups(const AbstractMetaClassList &classes) {
+    QHash<AbstractMetaClass *, AbstractMetaClass *> parents;
+
+    foreach(AbstractMetaClass *cls, classes) {
+        AbstractMetaClassList related = cls->interfaces();
+        if (cls->baseClass())
+            related << cls->baseClass();
+
+        foreach(AbstractMetaClass *other, related) {
+            AbstractMetaClass *a = class_group_root(&parents, cls);
+            AbstractMetaClass *b = class_group_root(&parents, other);
+            if (a != b)
+                parents.insert(a, b);
+        }
+    }
+
+    QList<AbstractMetaClassList> groups;
+    QHash<AbstractMetaClass *, int> group_index;
+    foreach(AbstractMetaClass *cls, classes) {
+        AbstractMetaClass *root = class_group_root(&parents, cls);
+        if (!group_index.contains(root)) {
+            group_index.insert(root, groups.size());
+            groups << AbstractMetaClassList();
+        }
+        groups[group_index.value(root)] << cls;
+    }
+
+    return groups;
+}
+
+class ClassPhaseJob : public QRunnable {
+    public:
+        ClassPhaseJob(AbstractMetaBuilder *builder, AbstractMetaBuilder::ClassPhase phase,
+                      const AbstractMetaClassList &classes)
+                : m_builder(builder), m_phase(phase), m_classes(classes) {}
+
+        void run() {
+            foreach(AbstractMetaClass *cls, m_classes)
+                m_builder->applyClassPhase(m_phase, cls);
+        }
+
+    private:
+        AbstractMetaBuilder *m_builder;
+        AbstractMetaBuilder::ClassPhase m_phase;
+        AbstractMetaClassList m_classes;
+};
+
+void AbstractMetaBuilder::runClassPhase(ClassPhase phase) {
+    if (m_thread_count <= 1) {
+        foreach(AbstractMetaClass *cls, m_meta_classes)
+            applyClassPhase(phase, cls);
+        return;
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(m_thread_count);
+    foreach(const AbstractMetaClassList &group, independent_class_groups(m_meta_classes))
+        pool.start(new ClassPhaseJob(this, phase, group));
+    pool.waitForDone();
+}
+
+void AbstractMetaBuilder::applyClassPhase(ClassPhase phase, AbstractMetaClass *cls) {
+    switch (phase) {
+        case FixFunctionsPhase:
+            cls->fixFunctions();
+
+            if (cls->typeEntry() == 0) {
+                ReportHandler::warning(QString("class '%1' does not have an entry in the type system")
+                                       .arg(cls->name()));
+            } else {
+                if (!cls->hasConstructors() && !cls->isFinalInCpp() && !cls->isInterface() && !cls->isNamespace())
+                    cls->addDefaultConstructor();
+            }
+
+            if (cls->isAbstract() && !cls->isInterface()) {
+                cls->typeEntry()->setLookupName(cls->typeEntry()->targetLangName() + "$ConcreteWrapper");
+            }
+            break;
+
+        case SetupOperatorsPhase:
+            setupEquals(cls);
+            setupComparable(cls);
+            setupClonable(cls);
+            break;
+    }
 }
 
 /**
@@ -196,6 +303,80 @@ void AbstractMetaBuilder::checkFunctionModifications() {
     }
 }
 
+/*
+ * Value types are flattened into a single jlong, so every field must be a
+ * primitive of at most 32 bits, and the Java side needs a constructor
+ * taking the fields in order to rebuild the object. Types that do not
+ * qualify are warned about and returned as objects as usual.
+ */
+void AbstractMetaBuilder::checkFlattenedValueTypes() {
+    static QStringList packable = QStringList() << "jint" << "jshort" << "jbyte" << "jchar" << "jboolean";
+
+    QList<TypeEntry *> entries = TypeDatabase::instance()->entries().values();
+    foreach(TypeEntry *type_entry, entries) {
+        if (type_entry == 0 || !type_entry->isValue())
+            continue;
+
+        ValueTypeEntry *entry = static_cast<ValueTypeEntry *>(type_entry);
+        QStringList fields = entry->flattenedFields();
+        if (fields.isEmpty())
+            continue;
+
+        QString problem;
+        AbstractMetaClass *cls = m_meta_classes.findClass(entry->qualifiedCppName());
+        AbstractMetaFunctionList getters = cls != 0 ? cls->flattenedFieldGetters() : AbstractMetaFunctionList();
+        if (cls == 0) {
+            problem = "the class is not declared";
+        } else if (fields.size() > 2) {
+            problem = "at most two fields fit in a jlong";
+        } else if (getters.isEmpty()) {
+            problem = "each field must name a public getter without arguments";
+        } else {
+            foreach(AbstractMetaFunction *getter, getters) {
+                if (!getter->type()->isPrimitive()
+                        || !packable.contains(getter->type()->typeEntry()->jniName())) {
+                    problem = QString("field '%1' is not a primitive of at most 32 bits")
+                              .arg(getter->originalName());
+                    break;
+                }
+            }
+        }
+
+        if (problem.isEmpty()) {
+            bool found = false;
+            AbstractMetaFunctionList constructors = cls->queryFunctions(AbstractMetaClass::Constructors
+                                                    | AbstractMetaClass::WasPublic
+                                                    | AbstractMetaClass::NotRemovedFromTargetLang);
+            foreach(AbstractMetaFunction *constructor, constructors) {
+                AbstractMetaArgumentList arguments = constructor->arguments();
+                if (arguments.size() != getters.size())
+                    continue;
+
+                found = true;
+                for (int i = 0; i < arguments.size(); ++i) {
+                    if (arguments.at(i)->type()->typeEntry() != getters.at(i)->type()->typeEntry()
+                            || constructor->argumentRemoved(i + 1)) {
+                        found = false;
+                        break;
+                    }
+                }
+
+                if (found)
+                    break;
+            }
+
+            if (!found)
+                problem = "no public constructor takes the fields in order";
+        }
+
+        if (!problem.isEmpty()) {
+            ReportHandler::warning(QString("value type '%1' cannot be flattened: %2")
+                                   .arg(entry->qualifiedCppName()).arg(problem));
+            entry->setFlattenedFields(QStringList());
+        }
+    }
+}
+
 AbstractMetaClass *AbstractMetaBuilder::argumentToClass(ArgumentModelItem argument, const QString &contextString) {
     AbstractMetaClass *returned = 0;
     bool ok = false;
@@ -435,21 +616,10 @@ bool AbstractMetaBuilder::build() {
         }
     }
 
-    foreach(AbstractMetaClass *cls, m_meta_classes) {
-        cls->fixFunctions();
-
-        if (cls->typeEntry() == 0) {
-            ReportHandler::warning(QString("class '%1' does not have an entry in the type system")
-                                   .arg(cls->name()));
-        } else {
-            if (!cls->hasConstructors() && !cls->isFinalInCpp() && !cls->isInterface() && !cls->isNamespace())
-                cls->addDefaultConstructor();
-        }
-
-        if (cls->isAbstract() && !cls->isInterface()) {
-            cls->typeEntry()->setLookupName(cls->typeEntry()->targetLangName() + "$ConcreteWrapper");
-        }
-    }
+    // Inheritance setup instantiates templates and registers types, so it
+    // stays serial. Function fix up only touches the class hierarchy it
+    // works on and can run on several threads.
+    runClassPhase(FixFunctionsPhase);
 
     QList<TypeEntry *> entries = TypeDatabase::instance()->entries().values();
     foreach(const TypeEntry *entry, entries) {
@@ -524,12 +694,9 @@ bool AbstractMetaBuilder::build() {
     figureOutEnumValues();
     figureOutDefaultEnumArguments();
     checkFunctionModifications();
+    checkFlattenedValueTypes();
 
-    foreach(AbstractMetaClass *cls, m_meta_classes) {
-        setupEquals(cls);
-        setupComparable(cls);
-        setupClonable(cls);
-    }
+    runClassPhase(SetupOperatorsPhase);
 
     dumpLog();
 
@@ -676,7 +843,8 @@ Operator findOperator(QString *s) {
 int AbstractMetaBuilder::figureOutEnumValue(const QString &origStringValue,
         int oldValuevalue,
         AbstractMetaEnum *meta_enum,
-        AbstractMetaFunction *meta_function) {
+        AbstractMetaFunction *meta_function,
+        bool *exact) {
     if (origStringValue.isEmpty())
         return oldValuevalue;
 
@@ -709,6 +877,7 @@ int AbstractMetaBuilder::figureOutEnumValue(const QString &origStringValue,
     int returnValue = 0;
 
     bool matched = false;
+    bool all_exact = true;
 
     for (int i = 0; i < stringValues.size(); ++i) {
         QString s = stringValues.at(i).trimmed();
@@ -728,6 +897,7 @@ int AbstractMetaBuilder::figureOutEnumValue(const QString &origStringValue,
 
         } else if (m_enum_values.contains(s)) {
             v = m_enum_values[s]->value();
+            all_exact = all_exact && m_enum_values[s]->isValueExact();
             matched = true;
 
         } else {
@@ -735,13 +905,16 @@ int AbstractMetaBuilder::figureOutEnumValue(const QString &origStringValue,
 
             if (meta_enum && (ev = meta_enum->values().find(s))) {
                 v = ev->value();
+                all_exact = all_exact && ev->isValueExact();
                 matched = true;
 
             } else if (meta_enum && (ev = meta_enum->enclosingClass()->findEnumValue(s, meta_enum))) {
                 v = ev->value();
+                all_exact = all_exact && ev->isValueExact();
                 matched = true;
 
             } else {
+                all_exact = false;
                 if (meta_enum)
                     ReportHandler::warning("unhandled enum value: " + s + " in "
                                            + meta_enum->enclosingClass()->name() + "::"
@@ -766,8 +939,11 @@ int AbstractMetaBuilder::figureOutEnumValue(const QString &origStringValue,
 
         ReportHandler::warning(warn);
         returnValue = oldValuevalue;
+        all_exact = false;
     }
 
+    if (exact)
+        *exact = all_exact;
     return returnValue;
 }
 
@@ -787,9 +963,14 @@ void AbstractMetaBuilder::figureOutEnumValuesForClass(AbstractMetaClass *meta_cl
             ReportHandler::warning("bad enum in class " + meta_class->name());
         AbstractMetaEnumValueList lst = e->values();
         int value = 0;
+        bool exact = true;
         for (int i = 0; i < lst.size(); ++i) {
-            value = figureOutEnumValue(lst.at(i)->stringValue(), value, e);
+            // Without an initializer the value follows the previous one
+            // and is exactly as reliable
+            if (!lst.at(i)->stringValue().isEmpty())
+                value = figureOutEnumValue(lst.at(i)->stringValue(), value, e, 0, &exact);
             lst.at(i)->setValue(value);
+            lst.at(i)->setValueExact(exact);
             value++;
         }
 
@@ -56,6 +56,11 @@ class AbstractMetaBuilder {
             NoReason
         };
 
+        enum ClassPhase {
+            FixFunctionsPhase,
+            SetupOperatorsPhase
+        };
+
         AbstractMetaBuilder();
         virtual ~AbstractMetaBuilder() {};
 
@@ -77,8 +82,15 @@ class AbstractMetaBuilder {
 
         bool build();
 
+        int threadCount() const { return m_thread_count; }
+        void setThreadCount(int count) { m_thread_count = count; }
+
+        void runClassPhase(ClassPhase phase);
+        void applyClassPhase(ClassPhase phase, AbstractMetaClass *cls);
+
         void figureOutEnumValuesForClass(AbstractMetaClass *meta_class, QSet<AbstractMetaClass *> *classes);
-        int figureOutEnumValue(const QString &name, int value, AbstractMetaEnum *meta_enum, AbstractMetaFunction *meta_function = 0);
+        int figureOutEnumValue(const QString &name, int value, AbstractMetaEnum *meta_enum, AbstractMetaFunction *meta_function = 0,
+                               bool *exact = 0);
         void figureOutEnumValues();
         void figureOutDefaultEnumArguments();
 
@@ -96,6 +108,7 @@ class AbstractMetaBuilder {
         AbstractMetaFunction *traverseFunction(FunctionModelItem function);
         AbstractMetaField *traverseField(VariableModelItem field, const AbstractMetaClass *cls);
         void checkFunctionModifications();
+        void checkFlattenedValueTypes();
         void registerHashFunction(FunctionModelItem function_item);
         void registerToStringCapability(FunctionModelItem function_item);
 
@@ -165,6 +178,8 @@ class AbstractMetaBuilder {
         QString m_namespace_prefix;
 
         QSet<AbstractMetaClass *> m_setup_inheritance_done;
+
+        int m_thread_count;
 };
 
 #endif // ABSTRACTMETBUILDER_H
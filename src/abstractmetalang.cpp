@@ -38,6 +38,9 @@
 #include "reporthandler.h"
 #include "typesystem/typedatabase.h"
 
+#include <QHash>
+#include <QVector>
+
 /*******************************************************************************
  * AbstractMetaType
  */
@@ -427,6 +430,21 @@ bool AbstractMetaFunction::resetObjectAfterUse(int argument_idx) const {
     return false;
 }
 
+TypeSystem::StringConversion AbstractMetaFunction::stringConversion(int argument_idx) const {
+    const AbstractMetaClass *cls = declaringClass();
+    FunctionModificationList modifications = this->modifications(cls);
+    foreach(FunctionModification modification, modifications) {
+        QList<ArgumentModification> argumentModifications = modification.argument_mods;
+        foreach(ArgumentModification argumentModification, argumentModifications) {
+            if (argumentModification.index == argument_idx
+                    && argumentModification.string_conversion != TypeSystem::DefaultStringConversion)
+                return argumentModification.string_conversion;
+        }
+    }
+
+    return TypeSystem::DefaultStringConversion;
+}
+
 QString AbstractMetaFunction::nullPointerDefaultValue(const AbstractMetaClass *mainClass, int argument_idx) const {
     Q_ASSERT(nullPointersDisabled(mainClass, argument_idx));
 
@@ -508,6 +526,16 @@ QString AbstractMetaFunction::argumentReplaced(int key) const {
     return "";
 }
 
+bool AbstractMetaFunction::hasFlattenedReturnType() const {
+    return type() != 0
+           && type()->isFlattenedValue()
+           && !isConstructor()
+           && typeReplaced(0).isEmpty()
+           && argumentReplaced(0).isEmpty()
+           && !argumentRemoved(0)
+           && conversionRule(TypeSystem::NativeCode, 0).isEmpty();
+}
+
 bool AbstractMetaFunction::argumentRemoved(int key) const {
     FunctionModificationList modifications = this->modifications(declaringClass());
     foreach(FunctionModification modification, modifications) {
@@ -816,6 +844,38 @@ AbstractMetaFunctionList AbstractMetaClass::queryFunctionsByName(const QString &
     return returned;
 }
 
+/*******************************************************************************
+ * Returns the getters named in the flatten attribute of a value type, in
+ * order, or an empty list if one of them is not a public no-argument
+ * member function of the class.
+ */
+AbstractMetaFunctionList AbstractMetaClass::flattenedFieldGetters() const {
+    AbstractMetaFunctionList returned;
+    if (!typeEntry()->isValue())
+        return returned;
+
+    QStringList fields = static_cast<const ValueTypeEntry *>(typeEntry())->flattenedFields();
+    foreach(QString field, fields) {
+        AbstractMetaFunction *getter = 0;
+        foreach(AbstractMetaFunction *function, m_functions) {
+            if (function->originalName() == field
+                    && function->arguments().isEmpty()
+                    && function->type() != 0
+                    && function->wasPublic()
+                    && !function->isStatic()) {
+                getter = function;
+                break;
+            }
+        }
+
+        if (getter == 0)
+            return AbstractMetaFunctionList();
+        returned.append(getter);
+    }
+
+    return returned;
+}
+
 /*******************************************************************************
  * Returns all reference count modifications for any function in the class
  */
@@ -1532,6 +1592,15 @@ static void add_extra_includes_for_function(AbstractMetaClass *meta_class, const
         add_extra_include_for_type(meta_class, argument->type());
 }
 
+static void index_function_for_fixup(AbstractMetaFunction *f, int index,
+                                     QHash<QString, QList<int> > *by_modified_name,
+                                     QHash<QString, QList<int> > *by_name,
+                                     QVector<bool> *removed) {
+    (*by_modified_name)[f->modifiedName()] << index;
+    (*by_name)[f->originalName()] << index;
+    removed->append(f->isRemovedFromAllLanguages(f->implementingClass()));
+}
+
 void AbstractMetaClass::fixFunctions() {
     if (m_functions_fixed)
         return;
@@ -1545,6 +1614,17 @@ void AbstractMetaClass::fixFunctions() {
 
     if (super_class != 0)
         super_class->fixFunctions();
+
+    // Index this class' functions by modified and original name so that
+    // each super class function only has to be compared against the
+    // functions it can possibly override or shadow. Removal state does
+    // not change during the fix up, so it is computed once per function.
+    QHash<QString, QList<int> > funcs_by_modified_name;
+    QHash<QString, QList<int> > funcs_by_name;
+    QVector<bool> funcs_removed;
+    for (int fi = 0; fi < funcs.size(); ++fi)
+        index_function_for_fixup(funcs.at(fi), fi, &funcs_by_modified_name, &funcs_by_name, &funcs_removed);
+
     int iface_idx = 0;
     while (super_class || iface_idx < interfaces().size()) {
 //         printf(" - base: %s\n", qPrintable(super_class->name()));
@@ -1575,9 +1655,21 @@ void AbstractMetaClass::fixFunctions() {
             // we generally don't care about private functions, but we have to get the ones that are
             // virtual in case they override abstract functions.
             bool add = (sf->isNormal() || sf->isSignal() || sf->isEmptyFunction());
-            for (int fi = 0; fi < funcs.size(); ++fi) {
+
+            // Only functions with the same modified or original name can
+            // affect sf; visit them in declaration order.
+            QList<int> candidates = funcs_by_modified_name.value(sf->modifiedName());
+            candidates += funcs_by_name.value(sf->originalName());
+            qSort(candidates);
+
+            int last_fi = -1;
+            foreach(int fi, candidates) {
+                if (fi == last_fi)
+                    continue;
+                last_fi = fi;
+
                 AbstractMetaFunction *f = funcs.at(fi);
-                if (f->isRemovedFromAllLanguages(f->implementingClass()))
+                if (funcs_removed.at(fi))
                     continue;
 
                 uint cmp = f->compareTo(sf);
@@ -1709,8 +1801,11 @@ void AbstractMetaClass::fixFunctions() {
                 funcs_to_add << sf;
         }
 
-        foreach(AbstractMetaFunction *f, funcs_to_add)
-            funcs << f->copy();
+        foreach(AbstractMetaFunction *f, funcs_to_add) {
+            AbstractMetaFunction *copy = f->copy();
+            index_function_for_fixup(copy, funcs.size(), &funcs_by_modified_name, &funcs_by_name, &funcs_removed);
+            funcs << copy;
+        }
 
         if (super_class)
             super_class = super_class->baseClass();
@@ -1756,12 +1851,14 @@ void AbstractMetaClass::fixFunctions() {
         (*this) -= AbstractMetaAttributes::Final;
     }
 
+    QHash<QString, AbstractMetaFunctionList> overloads;
+    foreach(AbstractMetaFunction *f, funcs)
+        overloads[f->originalName()] << f;
+
     foreach(AbstractMetaFunction *f1, funcs) {
-        foreach(AbstractMetaFunction *f2, funcs) {
+        foreach(AbstractMetaFunction *f2, overloads.value(f1->originalName())) {
             if (f1 != f2) {
-                uint cmp = f1->compareTo(f2);
-                if ((cmp & AbstractMetaFunction::EqualName)
-                        && !f1->isFinalInCpp()
+                if (!f1->isFinalInCpp()
                         && f2->isFinalInCpp()) {
                     *f2 += AbstractMetaAttributes::FinalOverload;
 //                     qDebug() << f2 << f2->implementingClass()->name() << "::" << f2->name() << f2->arguments().size() << " vs " << f1 << f1->implementingClass()->name() << "::" << f1->name() << f1->arguments().size();
@@ -1807,6 +1904,35 @@ QString AbstractMetaType::minimalSignature() const {
     return minimalSignature;
 }
 
+bool AbstractMetaType::isBulkContainer() const {
+    if (!isContainer() || m_instantiations.size() != 1)
+        return false;
+
+    switch (static_cast<const ContainerTypeEntry *>(typeEntry())->type()) {
+        case ContainerTypeEntry::ListContainer:
+        case ContainerTypeEntry::LinkedListContainer:
+        case ContainerTypeEntry::VectorContainer:
+        case ContainerTypeEntry::StackContainer:
+        case ContainerTypeEntry::QueueContainer:
+            break;
+        default:
+            return false;
+    }
+
+    const AbstractMetaType *element = m_instantiations.first();
+    if (!element->isPrimitive() || element->indirections() != 0)
+        return false;
+
+    return static_cast<const PrimitiveTypeEntry *>(element->typeEntry())->bulkContainers();
+}
+
+bool AbstractMetaType::isFlattenedValue() const {
+    if (!isValue() || indirections() != 0 || !typeEntry()->isValue())
+        return false;
+
+    return !static_cast<const ValueTypeEntry *>(typeEntry())->flattenedFields().isEmpty();
+}
+
 bool AbstractMetaType::hasNativeId() const {
     return (isQObject() || isValue() || isObject()) && typeEntry()->isNativeIdBased();
 }
@@ -223,6 +223,10 @@ class AbstractMetaType {
         // returns true if the type is used as a value type (X or const X &)
         bool isValue() const { return m_pattern == ValuePattern; }
 
+        // returns true if the type is a value type passed by value whose
+        // type entry lists flattened fields
+        bool isFlattenedValue() const;
+
         // returns true for more complex types...
         bool isNativePointer() const { return m_pattern == NativePointerPattern; }
 
@@ -244,6 +248,10 @@ class AbstractMetaType {
         // returns true if the type was used as a container
         bool isContainer() const { return m_pattern == ContainerPattern; }
 
+        // returns true if the type is a sequential container of a primitive type
+        // marked bulk-containers, which is passed to Java as a primitive array
+        bool isBulkContainer() const;
+
         // returns true if the type was used as a flag
         bool isFlags() const { return m_pattern == FlagsPattern; }
 
@@ -506,6 +514,7 @@ class AbstractMetaFunction : public AbstractMetaAttributes {
         QString nullPointerDefaultValue(const AbstractMetaClass *cls = 0, int argument_idx = 0) const;
 
         bool resetObjectAfterUse(int argument_idx) const;
+        TypeSystem::StringConversion stringConversion(int argument_idx) const;
 
         // Returns whether garbage collection is disabled for the argument in any context
         bool disabledGarbageCollection(const AbstractMetaClass *cls, int key) const;
@@ -524,6 +533,9 @@ class AbstractMetaFunction : public AbstractMetaAttributes {
         QString argumentReplaced(int key) const;
         bool needsSuppressUncheckedWarning() const;
 
+        // Returns true if the native function returns its value type packed in a jlong
+        bool hasFlattenedReturnType() const;
+
         bool hasModifications(const AbstractMetaClass *implementor) const;
         FunctionModificationList modifications(const AbstractMetaClass *implementor) const;
 
@@ -557,7 +569,7 @@ class AbstractMetaFunction : public AbstractMetaAttributes {
 class AbstractMetaEnumValue {
     public:
         AbstractMetaEnumValue()
-                : m_value_set(false), m_value(0) {
+                : m_value_set(false), m_value_exact(false), m_value(0) {
         }
 
         int value() const { return m_value; }
@@ -571,11 +583,17 @@ class AbstractMetaEnumValue {
 
         bool isValueSet() const { return m_value_set; }
 
+        // false if the value was guessed because its initializer, or one
+        // it depends on, could not be resolved
+        bool isValueExact() const { return m_value_exact; }
+        void setValueExact(bool exact) { m_value_exact = exact; }
+
     private:
         QString m_name;
         QString m_string_value;
 
         bool m_value_set;
+        bool m_value_exact;
         int m_value;
 };
 
@@ -694,6 +712,7 @@ class AbstractMetaClass : public AbstractMetaAttributes {
 
         AbstractMetaFunctionList queryFunctionsByName(const QString &name) const;
         AbstractMetaFunctionList queryFunctions(uint query) const;
+        AbstractMetaFunctionList flattenedFieldGetters() const;
         inline AbstractMetaFunctionList allVirtualFunctions() const;
         inline AbstractMetaFunctionList allFinalFunctions() const;
         AbstractMetaFunctionList functionsInTargetLang() const;
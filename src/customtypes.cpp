@@ -38,10 +38,9 @@
 #include "customtypes.h"
 
 #include <QtCore/QDebug>
-#include <QtCore/QTextStream>
 
 
-void QModelIndexTypeEntry::generateCppJavaToQt(QTextStream &s,
+void QModelIndexTypeEntry::generateCppJavaToQt(TextBuffer &s,
         const AbstractMetaType *,
         const QString &env_name,
         const QString &qt_name,
@@ -51,7 +50,7 @@ void QModelIndexTypeEntry::generateCppJavaToQt(QTextStream &s,
 }
 
 
-void QModelIndexTypeEntry::generateCppQtToJava(QTextStream &s,
+void QModelIndexTypeEntry::generateCppQtToJava(TextBuffer &s,
         const AbstractMetaType *,
         const QString &env_name,
         const QString &qt_name,
@@ -37,8 +37,7 @@
 #ifndef CUSTOMTYPES_H
 #define CUSTOMTYPES_H
 
-#include <QTextStream>
-
+#include "textbuffer.h"
 #include "typesystem/typesystem.h"
 #include "typesystem/typeentry.h"
 
@@ -53,13 +52,13 @@ class QModelIndexTypeEntry : public CustomTypeEntry {
 
         virtual bool isValue() const { return true; }
 
-        virtual void generateCppJavaToQt(QTextStream &s,
+        virtual void generateCppJavaToQt(TextBuffer &s,
                                          const AbstractMetaType *java_type,
                                          const QString &env_name,
                                          const QString &qt_name,
                                          const QString &java_name) const;
 
-        virtual void generateCppQtToJava(QTextStream &s,
+        virtual void generateCppQtToJava(TextBuffer &s,
                                          const AbstractMetaType *java_type,
                                          const QString &env_name,
                                          const QString &qt_name,
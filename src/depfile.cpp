@@ -0,0 +1,129 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QTextStream>
+
+#include <cstdio>
+
+#include "depfile.h"
+
+static const quint32 STAMP_MAGIC = 0x51474453;
+static const quint32 STAMP_VERSION = 1;
+
+static QByteArray file_hash(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return QCryptographicHash::hash(file.readAll(), QCryptographicHash::Sha1);
+}
+
+/**
+ * Escapes a path for the target or prerequisite list of a Makefile rule.
+ */
+static QString escape_make_path(const QString &path) {
+    QString escaped;
+    escaped.reserve(path.size());
+    for (int i = 0; i < path.size(); ++i) {
+        QChar c = path.at(i);
+        if (c == QLatin1Char(' ') || c == QLatin1Char('#') || c == QLatin1Char(':'))
+            escaped += QLatin1Char('\\');
+        else if (c == QLatin1Char('$'))
+            escaped += QLatin1Char('$');
+        escaped += c;
+    }
+    return escaped;
+}
+
+bool DepFile::writeDepfile(const QString &fileName, const QString &target, const QStringList &inputs) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        std::fprintf(stderr, "Failed to write depfile: %s\n", qPrintable(fileName));
+        return false;
+    }
+
+    QTextStream s(&file);
+    s << escape_make_path(target) << ":";
+    foreach(const QString &input, inputs)
+        s << " \\\n  " << escape_make_path(input);
+    s << "\n";
+    return true;
+}
+
+bool DepFile::writeStamp(const QString &fileName, const QByteArray &key,
+                         const QStringList &inputs, const QStringList &outputs) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::fprintf(stderr, "Failed to write input stamp: %s\n", qPrintable(fileName));
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_5);
+    stream << STAMP_MAGIC << STAMP_VERSION << key;
+
+    stream << quint32(inputs.size());
+    foreach(const QString &input, inputs) {
+        QFileInfo info(input);
+        stream << input << qint64(info.size()) << quint32(info.lastModified().toTime_t())
+               << file_hash(input);
+    }
+    stream << outputs;
+
+    return stream.status() == QDataStream::Ok;
+}
+
+/**
+ * Returns true if \a fileName was written by writeStamp() with the same
+ * \a key, all of its outputs still exist and none of its inputs changed.
+ * An input whose size and mtime match is taken as unchanged without
+ * reading it; only when the mtime moved is its content hash compared.
+ */
+bool DepFile::isUpToDate(const QString &fileName, const QByteArray &key) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_5);
+
+    quint32 magic, version;
+    QByteArray storedKey;
+    stream >> magic >> version;
+    if (magic != STAMP_MAGIC || version != STAMP_VERSION)
+        return false;
+    stream >> storedKey;
+    if (storedKey != key)
+        return false;
+
+    quint32 count;
+    stream >> count;
+    for (quint32 i = 0; i < count; ++i) {
+        QString path;
+        qint64 size;
+        quint32 modified;
+        QByteArray hash;
+        stream >> path >> size >> modified >> hash;
+        if (stream.status() != QDataStream::Ok)
+            return false;
+
+        QFileInfo info(path);
+        if (!info.isFile() || info.size() != size)
+            return false;
+        if (info.lastModified().toTime_t() != modified && file_hash(path) != hash)
+            return false;
+    }
+
+    QStringList outputs;
+    stream >> outputs;
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    foreach(const QString &output, outputs) {
+        if (!QFileInfo(output).exists())
+            return false;
+    }
+
+    return true;
+}
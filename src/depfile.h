@@ -0,0 +1,26 @@
+#ifndef DEPFILE_H_
+#define DEPFILE_H_
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Records which files a generator run read and wrote, so that a build
+ * system can tell when the generator has to run again.
+ *
+ * writeDepfile() writes the inputs as a Makefile rule, a format Ninja
+ * reads as well. writeStamp() stores the size, mtime and SHA-1 hash of
+ * every input; isUpToDate() compares them against the files on disk so
+ * that a run with unchanged inputs can stop before doing any work.
+ */
+class DepFile {
+    public:
+        static bool writeDepfile(const QString &fileName, const QString &target, const QStringList &inputs);
+
+        static bool writeStamp(const QString &fileName, const QByteArray &key,
+                               const QStringList &inputs, const QStringList &outputs);
+        static bool isUpToDate(const QString &fileName, const QByteArray &key);
+};
+
+#endif
@@ -39,9 +39,256 @@
 
 #include <QFileInfo>
 #include <QDir>
+#include <QDateTime>
+#include <QHash>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QPair>
+#include <QSet>
+#include <QTextCodec>
+
+#include <cstdio>
 
 bool FileOut::dummy = false;
 bool FileOut::diff = false;
+QStringList FileOut::outputFiles;
+
+struct ManifestEntry {
+    QByteArray hash;
+    qint64 size;
+    uint modified;
+};
+
+static const quint32 MANIFEST_MAGIC = 0x51474d46;
+static const quint32 MANIFEST_VERSION = 1;
+
+static QString manifest_file;
+// Outputs as they were after the previous run, and the content hash of
+// every output seen by this one.
+static QHash<QString, ManifestEntry> stored_manifest;
+static QHash<QString, QByteArray> current_manifest;
+
+/**
+ * Writes each file to a temporary next to it and renames it into place,
+ * so an interrupted run never leaves a half-written output behind.
+ * Returns false if the file on disk was not replaced.
+ */
+static bool write_file(const QString &fileName, const QByteArray &contents) {
+    QFileInfo info(fileName);
+    QDir dir(info.absolutePath());
+    if (!dir.mkpath(dir.absolutePath())) {
+        ReportHandler::warning(QString("unable to create directory '%1'")
+                               .arg(dir.absolutePath()));
+        return false;
+    }
+
+    QString tempName = fileName + ".part";
+    QFile temp(tempName);
+    if (!temp.open(QIODevice::WriteOnly)) {
+        ReportHandler::warning(QString("failed to open file '%1' for writing")
+                               .arg(tempName));
+        return false;
+    }
+    if (temp.write(contents) != contents.size()) {
+        ReportHandler::warning(QString("failed to write file '%1'").arg(tempName));
+        temp.close();
+        temp.remove();
+        return false;
+    }
+    temp.close();
+
+    // rename() replaces the target atomically on POSIX; elsewhere it
+    // refuses to overwrite and the old file is removed first.
+    if (std::rename(QFile::encodeName(tempName).constData(), QFile::encodeName(fileName).constData()) != 0) {
+        QFile::remove(fileName);
+        if (!QFile::rename(tempName, fileName)) {
+            ReportHandler::warning(QString("failed to rename '%1' to '%2'").arg(tempName).arg(fileName));
+            QFile::remove(tempName);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Background thread writing changed outputs. The queue is bounded so the
+ * generators can not run arbitrarily far ahead of the disk.
+ */
+class FileWriter : public QThread {
+    public:
+        enum { MaxQueuedFiles = 64 };
+
+        FileWriter() : m_busy(false), m_stopping(false), m_new_failures(0) { }
+
+        void enqueue(const QString &fileName, const QByteArray &contents) {
+            QMutexLocker locker(&m_mutex);
+            while (m_queue.size() >= MaxQueuedFiles)
+                m_not_full.wait(&m_mutex);
+            m_queue.enqueue(qMakePair(fileName, contents));
+            m_not_empty.wakeOne();
+        }
+
+        // Returns the number of writes that failed since the last call.
+        int waitUntilIdle() {
+            QMutexLocker locker(&m_mutex);
+            while (!m_queue.isEmpty() || m_busy)
+                m_idle.wait(&m_mutex);
+            int failures = m_new_failures;
+            m_new_failures = 0;
+            return failures;
+        }
+
+        bool hasFailed(const QString &path) {
+            QMutexLocker locker(&m_mutex);
+            return m_failed.contains(path);
+        }
+
+        int failedCount() {
+            QMutexLocker locker(&m_mutex);
+            return m_failed.size();
+        }
+
+        void stop() {
+            {
+                QMutexLocker locker(&m_mutex);
+                m_stopping = true;
+                m_not_empty.wakeOne();
+            }
+            wait();
+        }
+
+    protected:
+        void run() {
+            forever {
+                QPair<QString, QByteArray> job;
+                {
+                    QMutexLocker locker(&m_mutex);
+                    while (m_queue.isEmpty() && !m_stopping)
+                        m_not_empty.wait(&m_mutex);
+                    if (m_queue.isEmpty())
+                        return;
+                    job = m_queue.dequeue();
+                    m_busy = true;
+                    m_not_full.wakeOne();
+                }
+
+                bool written = write_file(job.first, job.second);
+
+                QMutexLocker locker(&m_mutex);
+                if (!written) {
+                    m_failed.insert(QFileInfo(job.first).absoluteFilePath());
+                    ++m_new_failures;
+                }
+                m_busy = false;
+                if (m_queue.isEmpty())
+                    m_idle.wakeAll();
+            }
+        }
+
+    private:
+        QMutex m_mutex;
+        QWaitCondition m_not_empty;
+        QWaitCondition m_not_full;
+        QWaitCondition m_idle;
+        QQueue<QPair<QString, QByteArray> > m_queue;
+        QSet<QString> m_failed;
+        bool m_busy;
+        bool m_stopping;
+        int m_new_failures;
+};
+
+static FileWriter *file_writer = 0;
+
+void FileOut::setManifestFile(const QString &fileName) {
+    manifest_file = fileName;
+    stored_manifest.clear();
+    current_manifest.clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_5);
+
+    quint32 magic, version, count;
+    stream >> magic >> version;
+    if (magic != MANIFEST_MAGIC || version != MANIFEST_VERSION)
+        return;
+
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString path;
+        ManifestEntry entry;
+        stream >> path >> entry.hash >> entry.size >> entry.modified;
+        stored_manifest.insert(path, entry);
+    }
+    if (stream.status() != QDataStream::Ok)
+        stored_manifest.clear();
+}
+
+int FileOut::waitForWrites() {
+    return file_writer ? file_writer->waitUntilIdle() : 0;
+}
+
+bool FileOut::writeFailed(const QString &fileName) {
+    return file_writer && file_writer->hasFailed(QFileInfo(fileName).absoluteFilePath());
+}
+
+int FileOut::finishWrites() {
+    int failures = 0;
+    if (file_writer) {
+        file_writer->stop();
+        failures = file_writer->failedCount();
+
+        // A failed write left the previous file in place, which the new
+        // hash does not describe.
+        foreach(const QString &path, current_manifest.keys()) {
+            if (file_writer->hasFailed(path))
+                current_manifest.remove(path);
+        }
+
+        delete file_writer;
+        file_writer = 0;
+    }
+
+    if (manifest_file.isEmpty() || dummy)
+        return failures;
+
+    QFile file(manifest_file);
+    if (!file.open(QIODevice::WriteOnly)) {
+        ReportHandler::warning(QString("failed to write output manifest '%1'").arg(manifest_file));
+        return failures;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_5);
+    stream << MANIFEST_MAGIC << MANIFEST_VERSION;
+
+    QList<QPair<QString, ManifestEntry> > entries;
+    for (QHash<QString, QByteArray>::const_iterator it = current_manifest.constBegin();
+            it != current_manifest.constEnd(); ++it) {
+        QFileInfo info(it.key());
+        if (!info.isFile())
+            continue;
+        ManifestEntry entry;
+        entry.hash = it.value();
+        entry.size = info.size();
+        entry.modified = info.lastModified().toTime_t();
+        entries << qMakePair(it.key(), entry);
+    }
+
+    stream << quint32(entries.size());
+    for (int i = 0; i < entries.size(); ++i) {
+        const ManifestEntry &entry = entries.at(i).second;
+        stream << entries.at(i).first << entry.hash << entry.size << entry.modified;
+    }
+    return failures;
+}
 
 #ifdef Q_OS_LINUX
 const char* colorDelete = "\033[31m";
@@ -57,8 +304,9 @@ const char* colorReset = "";
 
 FileOut::FileOut(QString n):
         m_name(n),
-        stream(&tmp),
-        isDone(false) {}
+        isDone(false) {
+    stream.reserve(16 * 1024);
+}
 
 static int* lcsLength(QList<QByteArray> a, QList<QByteArray> b) {
     const int height = a.size() + 1;
@@ -177,7 +425,27 @@ bool FileOut::done() {
     bool fileEqual = false;
     QFile fileRead(m_name);
     QFileInfo info(fileRead);
-    stream.flush();
+    QString path = info.absoluteFilePath();
+    outputFiles << path;
+    // Encoded the way the QTextStream this buffer replaces encoded it.
+    tmp = QTextCodec::codecForLocale()->fromUnicode(stream.string());
+
+    // An output whose size and mtime are what the manifest recorded still
+    // holds the content the manifest hashed, so comparing hashes is enough.
+    if (!manifest_file.isEmpty()) {
+        QByteArray hash = QCryptographicHash::hash(tmp, QCryptographicHash::Sha1);
+        current_manifest.insert(path, hash);
+
+        QHash<QString, ManifestEntry>::const_iterator it = stored_manifest.constFind(path);
+        if (it != stored_manifest.constEnd()
+                && it.value().hash == hash
+                && info.exists()
+                && info.size() == it.value().size
+                && info.lastModified().toTime_t() == it.value().modified) {
+            return false;
+        }
+    }
+
     QByteArray original;
     if (info.exists() && (diff || (info.size() == tmp.size()))) {
         if (!fileRead.open(QIODevice::ReadOnly)) {
@@ -193,21 +461,11 @@ bool FileOut::done() {
 
     if (!fileEqual) {
         if (!FileOut::dummy) {
-            QDir dir(info.absolutePath());
-            if (!dir.mkpath(dir.absolutePath())) {
-                ReportHandler::warning(QString("unable to create directory '%1'")
-                                       .arg(dir.absolutePath()));
-                return false;
-            }
-
-            QFile fileWrite(m_name);
-            if (!fileWrite.open(QIODevice::WriteOnly)) {
-                ReportHandler::warning(QString("failed to open file '%1' for writing")
-                                       .arg(fileWrite.fileName()));
-                return false;
+            if (!file_writer) {
+                file_writer = new FileWriter;
+                file_writer->start();
             }
-            stream.setDevice(&fileWrite);
-            stream << tmp;
+            file_writer->enqueue(m_name, tmp);
         }
         if (diff) {
             printf("%sFile: %s%s\n", colorInfo, qPrintable(m_name), colorReset);
@@ -39,7 +39,9 @@
 
 #include <QObject>
 #include <QFile>
-#include <QTextStream>
+#include <QStringList>
+
+#include "textbuffer.h"
 
 class FileOut : public QObject {
         Q_OBJECT
@@ -59,10 +61,31 @@ class FileOut : public QObject {
 
         QString name() const { return m_name; }
 
-        QTextStream stream;
+        TextBuffer stream;
 
         static bool dummy;
         static bool diff;
+        // Absolute path of every file passed through done(), written or not.
+        static QStringList outputFiles;
+
+        /**
+         * Keeps a hash of every output in \a fileName between runs, so
+         * that done() can tell an output is unchanged without reading it.
+         */
+        static void setManifestFile(const QString &fileName);
+
+        /**
+         * Changed outputs are written by a background thread, so done()
+         * returning true only means the file was queued. waitForWrites()
+         * waits until the queue is on disk and returns how many writes
+         * failed since it was last called; writeFailed() tells whether a
+         * particular file could not be written. finishWrites() also stops
+         * the thread and saves the manifest, leaving out failed files; it
+         * returns how many files failed over the whole run.
+         */
+        static int waitForWrites();
+        static bool writeFailed(const QString &fileName);
+        static int finishWrites();
 
     private:
         bool isDone;
@@ -41,6 +41,9 @@
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QCryptographicHash>
 
 Generator::Generator() {
     m_num_generated = 0;
@@ -54,24 +57,307 @@ void Generator::generate() {
         return;
     }
 
+    if (isIncremental())
+        loadFingerprints();
+
     foreach(AbstractMetaClass *cls, m_classes) {
         if (!shouldGenerate(cls))
             continue;
 
         QString fileName = fileNameForClass(cls);
+        QString filePath = resolveOutputDirectory() + "/" + subDirectoryForClass(cls) + "/" + fileName;
+
+        QByteArray fingerprint;
+        if (isIncremental()) {
+            fingerprint = outputFingerprint(cls);
+            if (isUpToDate(filePath, fingerprint)) {
+                ReportHandler::debugSparse(QString("unchanged: %1").arg(fileName));
+                writeSkipped(cls);
+                recordOutput(filePath, fingerprint);
+                FileOut::outputFiles << QFileInfo(filePath).absoluteFilePath();
+                ++m_num_generated;
+                continue;
+            }
+        }
+
         ReportHandler::debugSparse(QString("generating: %1").arg(fileName));
 
-        FileOut fileOut(resolveOutputDirectory() + "/" + subDirectoryForClass(cls) + "/" + fileName);
+        FileOut fileOut(filePath);
         write(fileOut.stream, cls);
 
         if (fileOut.done())
             ++m_num_generated_written;
         ++m_num_generated;
+
+        if (isIncremental())
+            recordOutput(filePath, fingerprint);
+    }
+
+    // done() only queued the changed files; discount those that failed.
+    m_num_generated_written -= FileOut::waitForWrites();
+
+    if (isIncremental())
+        saveFingerprints();
+}
+
+static const quint32 FINGERPRINT_MAGIC = 0x51474650;
+// Bump whenever the generated output changes for the same input.
+static const quint32 FINGERPRINT_VERSION = 4;
+
+static void fingerprint_add(QCryptographicHash &hash, const QString &s) {
+    hash.addData(s.toUtf8());
+    hash.addData("", 1);
+}
+
+static void fingerprint_add(QCryptographicHash &hash, uint value) {
+    hash.addData(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void fingerprint_add(QCryptographicHash &hash, const CodeSnipList &snips) {
+    fingerprint_add(hash, uint(snips.size()));
+    foreach(const CodeSnip &snip, snips) {
+        fingerprint_add(hash, uint(snip.language));
+        fingerprint_add(hash, uint(snip.position));
+        fingerprint_add(hash, snip.code());
+    }
+}
+
+static void fingerprint_add(QCryptographicHash &hash, const AbstractMetaType *type) {
+    if (!type) {
+        fingerprint_add(hash, QString());
+        return;
+    }
+    fingerprint_add(hash, type->cppSignature());
+    fingerprint_add(hash, type->typeEntry()->qualifiedTargetLangName());
+    fingerprint_add(hash, uint(type->typeEntry()->type()));
+    fingerprint_add(hash, uint(type->isBulkContainer()));
+    fingerprint_add(hash, uint(type->isFlattenedValue()));
+    if (type->isFlattenedValue())
+        fingerprint_add(hash, static_cast<const ValueTypeEntry *>(type->typeEntry())->flattenedFields().join(","));
+}
+
+static void fingerprint_add(QCryptographicHash &hash, const FunctionModificationList &mods) {
+    fingerprint_add(hash, uint(mods.size()));
+    foreach(const FunctionModification &mod, mods) {
+        fingerprint_add(hash, mod.signature);
+        fingerprint_add(hash, mod.modifiers);
+        fingerprint_add(hash, mod.renamedToName);
+        fingerprint_add(hash, mod.association);
+        fingerprint_add(hash, uint(mod.removal));
+        fingerprint_add(hash, mod.snips);
+
+        fingerprint_add(hash, uint(mod.argument_mods.size()));
+        foreach(const ArgumentModification &arg, mod.argument_mods) {
+            fingerprint_add(hash, uint(arg.index));
+            fingerprint_add(hash, uint(arg.removed_default_expression | arg.removed << 1
+                                       | arg.no_null_pointers << 2 | arg.reset_after_use << 3));
+            fingerprint_add(hash, arg.modified_type);
+            fingerprint_add(hash, arg.replace_value);
+            fingerprint_add(hash, arg.null_pointer_default_value);
+            fingerprint_add(hash, arg.replaced_default_expression);
+            fingerprint_add(hash, arg.conversion_rules);
+            fingerprint_add(hash, uint(arg.string_conversion));
+            for (QHash<TypeSystem::Language, TypeSystem::Ownership>::const_iterator it = arg.ownerships.constBegin();
+                    it != arg.ownerships.constEnd(); ++it) {
+                fingerprint_add(hash, uint(it.key()));
+                fingerprint_add(hash, uint(it.value()));
+            }
+            foreach(const ReferenceCount &count, arg.referenceCounts) {
+                fingerprint_add(hash, uint(count.action));
+                fingerprint_add(hash, count.variableName);
+                fingerprint_add(hash, count.conditional);
+                fingerprint_add(hash, count.declareVariable);
+                fingerprint_add(hash, uint(count.threadSafe));
+                fingerprint_add(hash, count.access);
+            }
+        }
+    }
+}
+
+/**
+ * Returns a hash of everything in the meta model that the per-class
+ * generators read for \a cls: its type entry with code snippets and
+ * modifications, its base class and interfaces, and the signatures,
+ * attributes and modifications of its functions, fields and enums.
+ */
+QByteArray Generator::classFingerprint(const AbstractMetaClass *cls) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    const ComplexTypeEntry *entry = cls->typeEntry();
+    fingerprint_add(hash, cls->qualifiedCppName());
+    fingerprint_add(hash, cls->fullName());
+    fingerprint_add(hash, cls->attributes());
+    fingerprint_add(hash, uint(entry->type()));
+    fingerprint_add(hash, uint(entry->codeGeneration()));
+    fingerprint_add(hash, uint(entry->typeFlags()));
+    fingerprint_add(hash, entry->lookupName());
+    fingerprint_add(hash, entry->targetLangName());
+    fingerprint_add(hash, entry->javaPackage());
+    fingerprint_add(hash, entry->defaultSuperclass());
+    fingerprint_add(hash, entry->implements());
+    fingerprint_add(hash, entry->targetType());
+    fingerprint_add(hash, uint(entry->isGenericClass()));
+    fingerprint_add(hash, uint(entry->isPolymorphicBase()));
+    fingerprint_add(hash, entry->polymorphicIdValue());
+    fingerprint_add(hash, uint(entry->expensePolicy().limit));
+    fingerprint_add(hash, entry->expensePolicy().cost);
+    if (entry->isValue())
+        fingerprint_add(hash, static_cast<const ValueTypeEntry *>(entry)->flattenedFields().join(","));
+    fingerprint_add(hash, entry->include().toString());
+    foreach(const Include &inc, entry->extraIncludes())
+        fingerprint_add(hash, inc.toString());
+    fingerprint_add(hash, entry->codeSnips());
+    fingerprint_add(hash, entry->functionModifications());
+    foreach(const FieldModification &mod, entry->fieldModifications()) {
+        fingerprint_add(hash, mod.name);
+        fingerprint_add(hash, mod.modifiers);
+        fingerprint_add(hash, mod.renamedToName);
+    }
+
+    for (const AbstractMetaClass *base = cls->baseClass(); base; base = base->baseClass())
+        fingerprint_add(hash, base->qualifiedCppName());
+    foreach(const AbstractMetaClass *iface, cls->interfaces())
+        fingerprint_add(hash, iface->qualifiedCppName());
+
+    foreach(const AbstractMetaFunction *f, cls->functions()) {
+        fingerprint_add(hash, f->minimalSignature());
+        fingerprint_add(hash, f->name());
+        fingerprint_add(hash, f->originalName());
+        fingerprint_add(hash, f->attributes());
+        fingerprint_add(hash, f->type());
+        fingerprint_add(hash, f->declaringClass() ? f->declaringClass()->qualifiedCppName() : QString());
+        fingerprint_add(hash, f->implementingClass() ? f->implementingClass()->qualifiedCppName() : QString());
+        foreach(const AbstractMetaArgument *arg, f->arguments()) {
+            fingerprint_add(hash, arg->name());
+            fingerprint_add(hash, arg->type());
+            fingerprint_add(hash, arg->defaultValueExpression());
+        }
+        fingerprint_add(hash, f->modifications(f->implementingClass() ? f->implementingClass() : cls));
+    }
+
+    foreach(const AbstractMetaField *field, cls->fields()) {
+        fingerprint_add(hash, field->name());
+        fingerprint_add(hash, field->attributes());
+        fingerprint_add(hash, field->type());
     }
+
+    foreach(const AbstractMetaEnum *e, cls->enums()) {
+        fingerprint_add(hash, e->name());
+        fingerprint_add(hash, e->attributes());
+        foreach(const AbstractMetaEnumValue *value, e->values()) {
+            fingerprint_add(hash, value->name());
+            fingerprint_add(hash, uint(value->value()));
+        }
+    }
+
+    return hash.result();
+}
+
+QByteArray Generator::buildId() {
+    QByteArray id = QByteArray::number(FINGERPRINT_VERSION) + " " __DATE__ " " __TIME__;
+
+    // The binary changes with every rebuild, also when this file was not
+    // recompiled.
+    QFileInfo self("/proc/self/exe");
+    if (self.exists()) {
+        QFileInfo binary(self.symLinkTarget());
+        id += " " + QByteArray::number(binary.size())
+              + " " + QByteArray::number(binary.lastModified().toTime_t());
+    }
+    return id;
+}
+
+QString Generator::fingerprintFile() const {
+    return resolveOutputDirectory() + "/." + metaObject()->className() + ".fingerprints";
+}
+
+void Generator::loadFingerprints() {
+    m_stored_outputs.clear();
+    m_current_outputs.clear();
+
+    QFile file(fingerprintFile());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_5);
+
+    quint32 magic, version;
+    QByteArray key;
+    stream >> magic >> version >> key;
+    if (magic != FINGERPRINT_MAGIC || version != FINGERPRINT_VERSION || key != m_incremental_key)
+        return;
+
+    quint32 count;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString fileName;
+        OutputRecord record;
+        stream >> fileName >> record.fingerprint >> record.size >> record.modified;
+        m_stored_outputs.insert(fileName, record);
+    }
+
+    if (stream.status() != QDataStream::Ok)
+        m_stored_outputs.clear();
+}
+
+void Generator::saveFingerprints() const {
+    // Sizes and mtimes are only final once the outputs are on disk.
+    FileOut::waitForWrites();
+
+    QFile file(fingerprintFile());
+    QDir dir = QFileInfo(file).dir();
+    if (!dir.exists())
+        dir.mkpath(dir.absolutePath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        ReportHandler::warning(QString("failed to write fingerprints '%1'").arg(file.fileName()));
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_5);
+    stream << FINGERPRINT_MAGIC << FINGERPRINT_VERSION << m_incremental_key;
+
+    QHash<QString, OutputRecord> outputs;
+    for (QHash<QString, QByteArray>::const_iterator it = m_current_outputs.constBegin();
+            it != m_current_outputs.constEnd(); ++it) {
+        QFileInfo info(it.key());
+        if (!info.isFile() || FileOut::writeFailed(it.key()))
+            continue;
+
+        OutputRecord record;
+        record.fingerprint = it.value();
+        record.size = info.size();
+        record.modified = info.lastModified().toTime_t();
+        outputs.insert(it.key(), record);
+    }
+
+    stream << quint32(outputs.size());
+    for (QHash<QString, OutputRecord>::const_iterator it = outputs.constBegin(); it != outputs.constEnd(); ++it)
+        stream << it.key() << it.value().fingerprint << it.value().size << it.value().modified;
+}
+
+/**
+ * An output is up to date if it was generated from the same fingerprint
+ * and the file still has the size and mtime it had afterwards.
+ */
+bool Generator::isUpToDate(const QString &fileName, const QByteArray &fingerprint) const {
+    QHash<QString, OutputRecord>::const_iterator it = m_stored_outputs.constFind(fileName);
+    if (it == m_stored_outputs.constEnd() || it.value().fingerprint != fingerprint)
+        return false;
+
+    QFileInfo info(fileName);
+    return info.isFile()
+           && info.size() == it.value().size
+           && info.lastModified().toTime_t() == it.value().modified;
+}
+
+void Generator::recordOutput(const QString &fileName, const QByteArray &fingerprint) {
+    m_current_outputs.insert(fileName, fingerprint);
 }
 
 void Generator::printClasses() {
-    QTextStream s(stdout);
+    QTextStream out(stdout);
 
     AbstractMetaClassList classes = m_classes;
     qSort(classes);
@@ -79,8 +365,9 @@ void Generator::printClasses() {
     foreach(AbstractMetaClass *cls, classes) {
         if (!shouldGenerate(cls))
             continue;
+        TextBuffer s;
         write(s, cls);
-        s << endl << endl;
+        out << s.string() << endl << endl;
     }
 }
 
@@ -103,7 +390,7 @@ QString Generator::fileNameForClass(const AbstractMetaClass *) const {
     return QString();
 }
 
-void Generator::write(QTextStream &, const AbstractMetaClass *) {
+void Generator::write(TextBuffer &, const AbstractMetaClass *) {
     Q_ASSERT(false);
 }
 
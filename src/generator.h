@@ -38,12 +38,14 @@
 #define GENERATOR_H
 
 #include "abstractmetalang.h"
+#include "textbuffer.h"
 #include "typesystem/typesystem.h"
 
 #include "codemodel.h"
 
 #include <QObject>
 #include <QFile>
+#include <QHash>
 
 class Generator : public QObject {
         Q_OBJECT
@@ -97,10 +99,27 @@ class Generator : public QObject {
         int numGenerated() { return m_num_generated; }
         int numGeneratedAndWritten() { return m_num_generated_written; }
 
+        /**
+         * Enables incremental generation: write() is skipped for classes
+         * whose fingerprint and output file did not change since the last
+         * run. \a key identifies the options the outputs were generated
+         * with; fingerprints stored under another key are ignored.
+         */
+        void setIncremental(const QByteArray &key) { m_incremental_key = key; }
+        bool isIncremental() const { return !m_incremental_key.isEmpty(); }
+
+        static QByteArray classFingerprint(const AbstractMetaClass *cls);
+
+        /**
+         * Identifies the generator binary, so that outputs written by a
+         * generator with different output logic are not reused.
+         */
+        static QByteArray buildId();
+
         virtual bool shouldGenerate(const AbstractMetaClass *) const { return true; }
         virtual QString subDirectoryForClass(const AbstractMetaClass *java_class) const;
         virtual QString fileNameForClass(const AbstractMetaClass *java_class) const;
-        virtual void write(QTextStream &s, const AbstractMetaClass *java_class);
+        virtual void write(TextBuffer &s, const AbstractMetaClass *java_class);
 
         bool hasDefaultConstructor(const AbstractMetaType *type);
 
@@ -108,12 +127,48 @@ class Generator : public QObject {
     protected:
         void verifyDirectoryFor(const QFile &file);
 
+        /**
+         * Called by generate() instead of write() when the output for
+         * \a cls is up to date. Generators that register their files
+         * somewhere while writing them do the same here.
+         */
+        virtual void writeSkipped(const AbstractMetaClass *) { }
+
+        /**
+         * Fingerprint of everything the output for \a cls depends on.
+         * Generators that read inputs beyond the meta model add them here.
+         */
+        virtual QByteArray outputFingerprint(const AbstractMetaClass *cls) const { return classFingerprint(cls); }
+
+        void loadFingerprints();
+        void saveFingerprints() const;
+        bool isUpToDate(const QString &fileName, const QByteArray &fingerprint) const;
+        void recordOutput(const QString &fileName, const QByteArray &fingerprint);
+
         AbstractMetaClassList m_classes;
         int m_num_generated;
         int m_num_generated_written;
         QString m_out_dir;
+
+    private:
+        struct OutputRecord {
+            QByteArray fingerprint;
+            qint64 size;
+            uint modified;
+        };
+
+        QString fingerprintFile() const;
+
+        QByteArray m_incremental_key;
+        QHash<QString, OutputRecord> m_stored_outputs;
+        QHash<QString, QByteArray> m_current_outputs;
 };
 
+/**
+ * Indentation state of one writer. Each generator owns its own Indentor,
+ * so generators running on different threads do not share a depth.
+ * The indent for each depth is built once and reused.
+ */
 class Indentor {
     public:
         Indentor():
@@ -125,8 +180,14 @@ class Indentor {
         const QString &string() const {
             return m_string;
         }
+        const QString &current() const {
+            while (m_levels.size() <= indent)
+                m_levels.append(m_string.repeated(m_levels.size()));
+            return m_levels.at(indent);
+        }
     private:
         QString m_string;
+        mutable QStringList m_levels;
 };
 
 class Indentation {
@@ -146,10 +207,8 @@ class Indentation {
         Indentor &indentor;
 };
 
-inline QTextStream &operator <<(QTextStream &s, const Indentor &indentor) {
-    for (int i = 0; i < indentor.indent; ++i)
-        s << indentor.string();
-    return s;
+inline TextBuffer &operator <<(TextBuffer &s, const Indentor &indentor) {
+    return s << indentor.current();
 }
 
 
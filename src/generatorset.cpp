@@ -35,6 +35,9 @@
 ****************************************************************************/
 
 #include "generatorset.h"
+#include "generator.h"
+
+#include <QCryptographicHash>
 
 GeneratorSet::GeneratorSet() :
         inDir("."),
@@ -53,3 +56,15 @@ bool GeneratorSet::readParameters(const QMap<QString, QString> args) {
 
     return !(args.contains("help") || args.contains("h") || args.contains("?"));
 }
+
+QByteArray GeneratorSet::argumentsKey(const QMap<QString, QString> &args) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(Generator::buildId());
+    for (QMap<QString, QString>::const_iterator it = args.constBegin(); it != args.constEnd(); ++it) {
+        hash.addData(it.key().toUtf8());
+        hash.addData("=", 1);
+        hash.addData(it.value().toUtf8());
+        hash.addData("\n", 1);
+    }
+    return hash.result();
+}
@@ -41,6 +41,7 @@
 #include <QString>
 #include <QStringList>
 #include <QMap>
+#include <QByteArray>
 
 class GeneratorSet : public QObject {
         Q_OBJECT
@@ -55,6 +56,13 @@ class GeneratorSet : public QObject {
         virtual QString generate() = 0;
 
         static GeneratorSet *getInstance();
+
+        /**
+         * Hash of the command line and the generator build. Outputs and
+         * stamps recorded under another key do not describe this run.
+         */
+        static QByteArray argumentsKey(const QMap<QString, QString> &args);
+
         QString inDir;
         QString cppOutDir;
         QString javaOutDir;
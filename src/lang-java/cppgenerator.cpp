@@ -54,7 +54,7 @@ QString CppGenerator::fixNormalizedSignatureForQt(const QString &signature) {
     return ret;
 }
 
-void CppGenerator::writeTypeInfo(QTextStream &s, const AbstractMetaType *type, Option options) {
+void CppGenerator::writeTypeInfo(TextBuffer &s, const AbstractMetaType *type, Option options) {
     if ((options & OriginalTypeDescription) && !type->originalTypeDescription().isEmpty()) {
         QString originalTypeDescription = type->originalTypeDescription();
 
@@ -117,7 +117,7 @@ void CppGenerator::writeTypeInfo(QTextStream &s, const AbstractMetaType *type, O
 }
 
 
-void CppGenerator::writeFunctionArguments(QTextStream &s,
+void CppGenerator::writeFunctionArguments(TextBuffer &s,
         const AbstractMetaArgumentList &arguments,
         Option option,
         int numArguments) {
@@ -159,7 +159,7 @@ void CppGenerator::writeFunctionArguments(QTextStream &s,
  * form "bool static_call".
  */
 
-void CppGenerator::writeFunctionSignature(QTextStream &s,
+void CppGenerator::writeFunctionSignature(TextBuffer &s,
         const AbstractMetaFunction *java_function,
         const AbstractMetaClass *implementor,
         const QString &name_prefix,
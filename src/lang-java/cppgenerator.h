@@ -63,15 +63,15 @@ class CppGenerator : public Generator {
         }
 
         static QString fixNormalizedSignatureForQt(const QString &signature);
-        static void writeTypeInfo(QTextStream &s, const AbstractMetaType *type, Option option = NoOption);
-        static void writeFunctionSignature(QTextStream &s, const AbstractMetaFunction *java_function,
+        static void writeTypeInfo(TextBuffer &s, const AbstractMetaType *type, Option option = NoOption);
+        static void writeFunctionSignature(TextBuffer &s, const AbstractMetaFunction *java_function,
                                            const AbstractMetaClass *implementor = 0,
                                            const QString &name_prefix = QString(),
                                            Option option = NoOption,
                                            const QString &classname_prefix = QString(),
                                            const QStringList &extra_arguments = QStringList(),
                                            int numArguments = -1);
-        static void writeFunctionArguments(QTextStream &s, const AbstractMetaArgumentList &arguments,
+        static void writeFunctionArguments(TextBuffer &s, const AbstractMetaArgumentList &arguments,
                                            Option option = NoOption,
                                            int numArguments = -1);
 
@@ -80,6 +80,10 @@ class CppGenerator : public Generator {
         QString signalWrapperPrefix() const { return "__qt_signalwrapper_"; }
 
         bool shouldGenerate(const AbstractMetaClass *java_class) const {
+            return generatesNativeCode(java_class);
+        }
+
+        static bool generatesNativeCode(const AbstractMetaClass *java_class) {
             return (!java_class->isNamespace() || java_class->functionsInTargetLang().size() > 0) && !java_class->isInterface()
                    && !java_class->typeEntry()->isVariant()
                    && (java_class->typeEntry()->codeGeneration() & TypeEntry::GenerateCpp)
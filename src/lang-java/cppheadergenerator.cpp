@@ -44,7 +44,7 @@ QString CppHeaderGenerator::fileNameForClass(const AbstractMetaClass *java_class
     return QString("qtjambishell_%1.h").arg(java_class->name());
 }
 
-void CppHeaderGenerator::writeFieldAccessors(QTextStream &s, const AbstractMetaField *java_field) {
+void CppHeaderGenerator::writeFieldAccessors(TextBuffer &s, const AbstractMetaField *java_field) {
     Q_ASSERT(java_field->isProtected());
 
     const AbstractMetaFunction *setter = java_field->setter();
@@ -56,7 +56,7 @@ void CppHeaderGenerator::writeFieldAccessors(QTextStream &s, const AbstractMetaF
     writeFunction(s, getter);
 }
 
-void CppHeaderGenerator::writeSignalWrapper(QTextStream &s, const AbstractMetaFunction *signal) {
+void CppHeaderGenerator::writeSignalWrapper(TextBuffer &s, const AbstractMetaFunction *signal) {
     s << "    ";
     writeFunctionSignature(s, signal, 0, signalWrapperPrefix(),
                            Option(NormalizeAndFixTypeSignature | OriginalName |
@@ -64,7 +64,7 @@ void CppHeaderGenerator::writeSignalWrapper(QTextStream &s, const AbstractMetaFu
     s << ";" << endl;
 }
 
-void CppHeaderGenerator::writeSignalWrappers(QTextStream &s, const AbstractMetaClass *java_class) {
+void CppHeaderGenerator::writeSignalWrappers(TextBuffer &s, const AbstractMetaClass *java_class) {
     AbstractMetaFunctionList signal_funcs = signalFunctions(java_class);
     if (signal_funcs.size() > 0) {
         s << endl << "public slots:" << endl;
@@ -74,7 +74,7 @@ void CppHeaderGenerator::writeSignalWrappers(QTextStream &s, const AbstractMetaC
     }
 }
 
-void CppHeaderGenerator::writeWrapperClass(QTextStream &s, const AbstractMetaClass *java_class) {
+void CppHeaderGenerator::writeWrapperClass(TextBuffer &s, const AbstractMetaClass *java_class) {
     AbstractMetaFunctionList signal_functions = signalFunctions(java_class);
     if (signal_functions.size() == 0)
         return ;
@@ -89,7 +89,7 @@ void CppHeaderGenerator::writeWrapperClass(QTextStream &s, const AbstractMetaCla
     << "};" << endl << endl;
 }
 
-void CppHeaderGenerator::write(QTextStream &s, const AbstractMetaClass *java_class) {
+void CppHeaderGenerator::write(TextBuffer &s, const AbstractMetaClass *java_class) {
     QString include_block = "QTJAMBISHELL_" + java_class->name().toUpper() + "_H";
 
     s << "#ifndef " << include_block << endl
@@ -211,12 +211,18 @@ void CppHeaderGenerator::write(QTextStream &s, const AbstractMetaClass *java_cla
     priGenerator->addHeader(pro_file_name, fileNameForClass(java_class));
 }
 
+void CppHeaderGenerator::writeSkipped(const AbstractMetaClass *java_class) {
+    QString pro_file_name = java_class->package().replace(".", "_") + "/" +
+                            java_class->package().replace(".", "_") + ".pri";
+    priGenerator->addHeader(pro_file_name, fileNameForClass(java_class));
+}
+
 
 /*!
     Writes out declarations of virtual C++ functions so that they
     can be reimplemented from the java side.
 */
-void CppHeaderGenerator::writeFunction(QTextStream &s, const AbstractMetaFunction *java_function, int options) {
+void CppHeaderGenerator::writeFunction(TextBuffer &s, const AbstractMetaFunction *java_function, int options) {
     if (java_function->isModifiedRemoved(TypeSystem::ShellCode))
         return;
 
@@ -225,7 +231,7 @@ void CppHeaderGenerator::writeFunction(QTextStream &s, const AbstractMetaFunctio
     s << ";" << endl;
 }
 
-void CppHeaderGenerator::writePublicFunctionOverride(QTextStream &s,
+void CppHeaderGenerator::writePublicFunctionOverride(TextBuffer &s,
         const AbstractMetaFunction *java_function) {
     s << "    ";
     writeFunctionSignature(s, java_function, 0, "__public_", Option(EnumAsInts |
@@ -234,7 +240,7 @@ void CppHeaderGenerator::writePublicFunctionOverride(QTextStream &s,
 }
 
 
-void CppHeaderGenerator::writeVirtualFunctionOverride(QTextStream &s,
+void CppHeaderGenerator::writeVirtualFunctionOverride(TextBuffer &s,
         const AbstractMetaFunction *java_function) {
     if (java_function->isModifiedRemoved(TypeSystem::NativeCode))
         return;
@@ -246,20 +252,20 @@ void CppHeaderGenerator::writeVirtualFunctionOverride(QTextStream &s,
 }
 
 
-void CppHeaderGenerator::writeForwardDeclareSection(QTextStream &s, const AbstractMetaClass *) {
+void CppHeaderGenerator::writeForwardDeclareSection(TextBuffer &s, const AbstractMetaClass *) {
     s << endl
     << "class QtJambiFunctionTable;" << endl
     << "class QtJambiLink;" << endl;
 }
 
 
-void CppHeaderGenerator::writeVariablesSection(QTextStream &s, const AbstractMetaClass *) {
+void CppHeaderGenerator::writeVariablesSection(TextBuffer &s, const AbstractMetaClass *) {
     s << endl
     << "    QtJambiFunctionTable *m_vtable;" << endl
     << "    QtJambiLink *m_link;" << endl;
 }
 
-void CppHeaderGenerator::writeInjectedCode(QTextStream &s, const AbstractMetaClass *java_class) {
+void CppHeaderGenerator::writeInjectedCode(TextBuffer &s, const AbstractMetaClass *java_class) {
     CodeSnipList code_snips = java_class->typeEntry()->codeSnips();
     foreach(const CodeSnip &cs, code_snips) {
         if (cs.language == TypeSystem::ShellDeclaration) {
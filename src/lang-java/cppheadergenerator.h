@@ -50,17 +50,18 @@ class CppHeaderGenerator : public CppGenerator {
 
         virtual QString fileNameForClass(const AbstractMetaClass *cls) const;
 
-        void write(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeFunction(QTextStream &s, const AbstractMetaFunction *java_function, int options = 0);
-        void writePublicFunctionOverride(QTextStream &s, const AbstractMetaFunction *java_function);
-        void writeVirtualFunctionOverride(QTextStream &s, const AbstractMetaFunction *java_function);
-        void writeForwardDeclareSection(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeVariablesSection(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeFieldAccessors(QTextStream &s, const AbstractMetaField *java_field);
-        void writeSignalWrapper(QTextStream &s, const AbstractMetaFunction *java_function);
-        void writeSignalWrappers(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeWrapperClass(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeInjectedCode(QTextStream &s, const AbstractMetaClass *java_class);
+        void write(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeSkipped(const AbstractMetaClass *java_class);
+        void writeFunction(TextBuffer &s, const AbstractMetaFunction *java_function, int options = 0);
+        void writePublicFunctionOverride(TextBuffer &s, const AbstractMetaFunction *java_function);
+        void writeVirtualFunctionOverride(TextBuffer &s, const AbstractMetaFunction *java_function);
+        void writeForwardDeclareSection(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeVariablesSection(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeFieldAccessors(TextBuffer &s, const AbstractMetaField *java_field);
+        void writeSignalWrapper(TextBuffer &s, const AbstractMetaFunction *java_function);
+        void writeSignalWrappers(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeWrapperClass(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeInjectedCode(TextBuffer &s, const AbstractMetaClass *java_class);
 
         bool shouldGenerate(const AbstractMetaClass *java_class) const {
             return (java_class->generateShellClass()
@@ -45,8 +45,6 @@
 #define VOID_POINTER_ORDINAL 8
 #include "typesystem/typedatabase.h"
 
-static Indentor INDENT;
-
 QString jni_signature(const AbstractMetaFunction *function, JNISignatureFormat format) {
     QString returned = "(";
     AbstractMetaArgumentList arguments = function->arguments();
@@ -122,7 +120,9 @@ QString jni_signature(const AbstractMetaType *java_type, JNISignatureFormat form
         return "V";
 
     if (java_type->isArray()) {
-        return "_3" + jni_signature(java_type->arrayElementType(), format);
+        return (format == Underscores ? "_3" : "[") + jni_signature(java_type->arrayElementType(), format);
+    } else if (java_type->isBulkContainer()) {
+        return (format == Underscores ? "_3" : "[") + jni_signature(java_type->instantiations().first(), format);
     } else if (java_type->isNativePointer()) {
         if (format == Underscores)
             return "Lcom_trolltech_qt_QNativePointer_2";
@@ -256,6 +256,9 @@ QByteArray jniName(const QString &name) {
 }
 
 QString CppImplGenerator::jniReturnName(const AbstractMetaFunction *java_function) {
+    if (java_function->hasFlattenedReturnType())
+        return "jlong";
+
     QString return_type = translateType(java_function->type(), EnumAsInts);
     QString new_return_type = java_function->typeReplaced(0);
     if (!new_return_type.isEmpty()) {
@@ -264,6 +267,60 @@ QString CppImplGenerator::jniReturnName(const AbstractMetaFunction *java_functio
     return return_type;
 }
 
+/**
+ * Returns the slash separated Java class name of an enum or flags type,
+ * as qtjambi_from_enum() and qtjambi_from_flags() expect it.
+ */
+QString CppImplGenerator::classHandleJavaName(const TypeEntry *entry) {
+    Q_ASSERT(entry->isEnum() || entry->isFlags());
+    QString qualifier = entry->isFlags()
+                        ? static_cast<const FlagsTypeEntry *>(entry)->originator()->javaQualifier()
+                        : static_cast<const EnumTypeEntry *>(entry)->javaQualifier();
+    return entry->javaPackage().replace('.', '/') + '/' + qualifier + '$' + entry->targetLangName();
+}
+
+/**
+ * Returns the name of the index of \a entry in the class handle table
+ * MetaInfoGenerator writes into each package's metainfo.h.
+ */
+QString CppImplGenerator::classHandleName(const TypeEntry *entry) {
+    return "__class_handle_" + classHandleJavaName(entry).replace('/', '_').replace('$', '_');
+}
+
+/**
+ * Returns the name of the string pool that holds the method names and
+ * signatures of the shell classes in \a package.
+ */
+QString CppImplGenerator::methodPoolName(const QString &package) {
+    return "__qt_method_pool_" + QString(package).replace(".", "_");
+}
+
+/**
+ * Returns the name of the offset of \a string in its package's method
+ * pool. Characters that can not appear in an identifier are escaped the
+ * way JNI escapes them, so distinct strings get distinct names.
+ */
+QString CppImplGenerator::methodPoolOffsetName(const QString &string) {
+    QString name = "__method_pool_";
+    foreach(QChar c, string) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+            name += c;
+        else if (c == '_')
+            name += "_1";
+        else
+            name += "_0" + QString("%1").arg(c.unicode(), 4, 16, QLatin1Char('0'));
+    }
+    return name;
+}
+
+void CppImplGenerator::writeMethodString(TextBuffer &s, const AbstractMetaClass *java_class,
+        const QString &string) {
+    if (methodPool())
+        s << methodPoolName(java_class->package()) << " + " << methodPoolOffsetName(string);
+    else
+        s << "\"" << string << "\"";
+}
+
 
 QByteArray jniTypeName(const AbstractMetaType *java_type) {
     if (!java_type) {
@@ -279,6 +336,17 @@ QByteArray jniTypeName(const AbstractMetaType *java_type) {
     }
 }
 
+/**
+ * Returns the part of the JNI array function names for the elements of a
+ * bulk container, "Int" for New<Int>Array(). It is derived from the
+ * jni-name that Handler validated for bulk-containers.
+ */
+static QString bulk_array_type(const TypeEntry *element) {
+    QString name = element->jniName().mid(1);
+    name[0] = name.at(0).toUpper();
+    return name;
+}
+
 QByteArray newXxxArray(const AbstractMetaType *java_type) {
     return "New" + jniTypeName(java_type) + "Array";
 }
@@ -329,11 +397,19 @@ QString jni_function_signature(QString package,
     if (options & CppImplGenerator::JNIExport)
         s += "Q_DECL_EXPORT ";
 
+    // Registered functions are only reached through RegisterNatives(), so
+    // they need no external linkage
+    if (options & CppImplGenerator::Registered)
+        s += "static ";
+
     if (options & CppImplGenerator::ReturnType) {
         s += return_type;
         s += " ";
     }
 
+    if (options & CppImplGenerator::Registered)
+        s += "JNICALL ";
+
     if (options & CppImplGenerator::JNIExport)
         s += "JNICALL QTJAMBI_FUNCTION_PREFIX(";
 
@@ -355,7 +431,114 @@ QString CppImplGenerator::fileNameForClass(const AbstractMetaClass *java_class)
     return QString("qtjambishell_%1.cpp").arg(java_class->name());
 }
 
-void CppImplGenerator::writeSignalFunction(QTextStream &s, const AbstractMetaFunction *signal, const AbstractMetaClass *cls,
+/**
+ * Returns the number of JNI local references the conversion of a value of
+ * \a java_type between Qt and Java creates, or -1 if it is not bounded
+ * or not known to the generator, as for containers or custom code.
+ */
+int CppImplGenerator::localReferenceCount(const AbstractMetaType *java_type,
+        const AbstractMetaFunction *java_function, int argument_index, Option option) {
+    if (!java_function->conversionRule(TypeSystem::NativeCode, argument_index).isEmpty()
+            || !java_function->conversionRule(TypeSystem::ShellCode, argument_index).isEmpty())
+        return -1;
+
+    if (java_type == 0)
+        return 0;
+
+    if (java_type->isArray())
+        return java_type->arrayElementType()->isPrimitive() ? 1 : -1;
+
+    if (java_type->isBulkContainer())
+        return 1;
+
+    if (java_type->isContainer() || (!java_type->isNativePointer() && java_type->typeEntry()->isCustom()))
+        return -1;
+
+    if (java_type->isPrimitive() || java_type->isIntegerEnum() || java_type->isIntegerFlags()
+            || ((option & EnumAsInts) && (java_type->isEnum() || java_type->isFlags())))
+        return (option & BoxedPrimitive) ? 1 : 0;
+
+    if (java_type->isTargetLangChar())
+        return 0;
+
+    return 1;
+}
+
+/**
+ * Returns the capacity of the local frame a shell function opens around
+ * its call into Java: one reference for the Java object and one for each
+ * converted argument and the return value. Returns -1 if a conversion
+ * can create any number of references.
+ */
+int CppImplGenerator::shellFunctionFrameSize(const AbstractMetaFunction *java_function) {
+    int size = 1;
+    if (java_function->nullPointersDisabled())
+        ++size;
+
+    QString new_return_type = java_function->typeReplaced(0);
+    if (!new_return_type.isEmpty()) {
+        if (new_return_type != "void")
+            return -1;
+    } else {
+        int count = localReferenceCount(java_function->type(), java_function, 0);
+        if (count < 0)
+            return -1;
+        size += count;
+    }
+
+    foreach(const AbstractMetaArgument *argument, java_function->arguments()) {
+        if (java_function->argumentRemoved(argument->argumentIndex() + 1))
+            continue;
+        int count = localReferenceCount(argument->type(), java_function, argument->argumentIndex() + 1);
+        if (count < 0)
+            return -1;
+        size += count;
+    }
+    return size;
+}
+
+/**
+ * Returns the capacity of the local frame of a signal wrapper, 0 when it
+ * creates no local references, or -1 if that is not known.
+ */
+int CppImplGenerator::signalFunctionFrameSize(const AbstractMetaFunction *signal, const AbstractMetaClass *cls) {
+    for (const AbstractMetaClass *c = cls; c != 0; c = c->baseClass()) {
+        foreach(const FunctionModification &mod, signal->modifications(c)) {
+            foreach(const CodeSnip &snip, mod.snips) {
+                if (snip.language & TypeSystem::Signal)
+                    return -1;
+            }
+        }
+        if (c == c->baseClass())
+            break;
+    }
+
+    int size = 0;
+    foreach(const AbstractMetaArgument *argument, signal->arguments()) {
+        int count = localReferenceCount(argument->type(), signal, argument->argumentIndex() + 1, BoxedPrimitive);
+        if (count < 0)
+            return -1;
+        size += count;
+    }
+    return size;
+}
+
+/**
+ * Opens a local frame of \a size references, as returned by
+ * shellFunctionFrameSize(). No frame is needed for 0, and an unknown size
+ * gets the generous default.
+ */
+void CppImplGenerator::writePushLocalFrame(TextBuffer &s, int size) {
+    if (size != 0)
+        s << INDENT << "__jni_env->PushLocalFrame(" << (size < 0 ? 100 : size) << ");" << endl;
+}
+
+void CppImplGenerator::writePopLocalFrame(TextBuffer &s, int size) {
+    if (size != 0)
+        s << INDENT << "__jni_env->PopLocalFrame(0);" << endl;
+}
+
+void CppImplGenerator::writeSignalFunction(TextBuffer &s, const AbstractMetaFunction *signal, const AbstractMetaClass *cls,
         int pos) {
     writeFunctionSignature(s, signal, cls, signalWrapperPrefix(),
                            Option(OriginalName | OriginalTypeDescription),
@@ -375,8 +558,9 @@ void CppImplGenerator::writeSignalFunction(QTextStream &s, const AbstractMetaFun
             s << INDENT << "jvalue arguments[" << arguments.size() << "];" << endl;
         else
             s << INDENT << "jvalue *arguments = 0;" << endl;
-        s << INDENT << "JNIEnv *__jni_env = qtjambi_current_environment();" << endl
-        << INDENT << "__jni_env->PushLocalFrame(100);" << endl;
+        int frameSize = signalFunctionFrameSize(signal, cls);
+        s << INDENT << "JNIEnv *__jni_env = qtjambi_current_environment();" << endl;
+        writePushLocalFrame(s, frameSize);
 
         writeCodeInjections(s, signal, cls, CodeSnip::Beginning, TypeSystem::Signal);
 
@@ -395,7 +579,7 @@ void CppImplGenerator::writeSignalFunction(QTextStream &s, const AbstractMetaFun
         << endl;
 
         writeCodeInjections(s, signal, cls, CodeSnip::End, TypeSystem::Signal);
-        s << INDENT << "__jni_env->PopLocalFrame(0);" << endl;
+        writePopLocalFrame(s, frameSize);
 
         s << INDENT << "  QTJAMBI_DEBUG_TRACE(\"(shell)  leaving: ";
         writeFunctionSignature(s, signal, cls, signalWrapperPrefix(),
@@ -416,7 +600,7 @@ bool CppImplGenerator::hasCustomDestructor(const AbstractMetaClass *java_class)
     return !java_class->isQObject() && !java_class->typeEntry()->isValue();
 }
 
-void CppImplGenerator::write(QTextStream &s, const AbstractMetaClass *java_class) {
+void CppImplGenerator::write(TextBuffer &s, const AbstractMetaClass *java_class) {
 
     bool shellClass = java_class->generateShellClass();
 
@@ -469,6 +653,9 @@ void CppImplGenerator::write(QTextStream &s, const AbstractMetaClass *java_class
     << "#include <qtjambi/qtjambifunctiontable.h>" << endl
     << "#include <qtjambi/qtjambilink.h>" << endl;
 
+    if (classHandleTable() || methodPool() || registerNatives())
+        s << "#include \"metainfo.h\"" << endl;
+
     writeShellSignatures(s, java_class);
 
     writeDefaultConstructedValues(s, java_class);
@@ -593,11 +780,21 @@ void CppImplGenerator::write(QTextStream &s, const AbstractMetaClass *java_class
 
     s << endl << endl;
 
+    if (registerNatives()) {
+        s << "// emitting (writeRegisterNatives)" << endl;
+        writeRegisterNatives(s, java_class);
+    }
+
+    QString pro_file_name = java_class->package().replace(".", "_") + "/" + java_class->package().replace(".", "_") + ".pri";
+    priGenerator->addSource(pro_file_name, fileNameForClass(java_class));
+}
+
+void CppImplGenerator::writeSkipped(const AbstractMetaClass *java_class) {
     QString pro_file_name = java_class->package().replace(".", "_") + "/" + java_class->package().replace(".", "_") + ".pri";
     priGenerator->addSource(pro_file_name, fileNameForClass(java_class));
 }
 
-void CppImplGenerator::writeJavaLangObjectOverrideFunctions(QTextStream &s, const AbstractMetaClass *cls) {
+void CppImplGenerator::writeJavaLangObjectOverrideFunctions(TextBuffer &s, const AbstractMetaClass *cls) {
     if (cls->hasHashFunction()) {
         AbstractMetaFunctionList hashcode_functions = cls->queryFunctionsByName("hashCode");
         bool found = false;
@@ -610,7 +807,7 @@ void CppImplGenerator::writeJavaLangObjectOverrideFunctions(QTextStream &s, cons
 
         if (!found) {
             s << endl
-            << INDENT << jni_function_signature(cls->package(), cls->name(), "__qt_hashCode", "jint")
+            << INDENT << nativeFunction(cls, "__qt_hashCode", "jint", "(J)I")
             << "(JNIEnv *__jni_env, jobject, jlong __this_nativeId)" << endl
             << INDENT << "{" << endl;
             {
@@ -640,7 +837,7 @@ void CppImplGenerator::writeJavaLangObjectOverrideFunctions(QTextStream &s, cons
 
         if (!found) {
             s << endl
-            << INDENT << jni_function_signature(cls->package(), cls->name(), "__qt_toString", "jstring")
+            << INDENT << nativeFunction(cls, "__qt_toString", "jstring", "(J)Ljava/lang/String;")
             << "(JNIEnv *__jni_env, jobject, jlong __this_nativeId)" << endl
             << INDENT << "{" << endl;
             {
@@ -656,7 +853,7 @@ void CppImplGenerator::writeJavaLangObjectOverrideFunctions(QTextStream &s, cons
     }
 }
 
-void CppImplGenerator::writeExtraFunctions(QTextStream &s, const AbstractMetaClass *java_class) {
+void CppImplGenerator::writeExtraFunctions(TextBuffer &s, const AbstractMetaClass *java_class) {
     const ComplexTypeEntry *class_type = java_class->typeEntry();
     Q_ASSERT(class_type);
 
@@ -668,7 +865,7 @@ void CppImplGenerator::writeExtraFunctions(QTextStream &s, const AbstractMetaCla
     }
 }
 
-void CppImplGenerator::writeToStringFunction(QTextStream &s, const AbstractMetaClass *java_class) {
+void CppImplGenerator::writeToStringFunction(TextBuffer &s, const AbstractMetaClass *java_class) {
     FunctionModelItem fun = java_class->hasToStringCapability();
     bool core = java_class->package() == QLatin1String("com.trolltech.qt.core");
     bool qevent = false;
@@ -690,7 +887,7 @@ void CppImplGenerator::writeToStringFunction(QTextStream &s, const AbstractMetaC
 
         s << endl;
         s << "#include <QtCore/QDebug>" << endl;
-        s << jni_function_signature(java_class->package(), java_class->name(), "__qt_toString", "jstring")
+        s << nativeFunction(java_class, "__qt_toString", "jstring", "(J)Ljava/lang/String;")
         << "(JNIEnv *__jni_env, jobject, jlong __this_nativeId)" << endl
         << INDENT << "{" << endl;
         {
@@ -709,9 +906,10 @@ void CppImplGenerator::writeToStringFunction(QTextStream &s, const AbstractMetaC
     }
 }
 
-void CppImplGenerator::writeCloneFunction(QTextStream &s, const AbstractMetaClass *java_class) {
+void CppImplGenerator::writeCloneFunction(TextBuffer &s, const AbstractMetaClass *java_class) {
     s << endl
-    << jni_function_signature(java_class->package(), java_class->name(), "__qt_clone", "jobject") << endl
+    << nativeFunction(java_class, "__qt_clone", "jobject",
+                      "(J)" + jni_signature(java_class->fullName(), SlashesAndStuff)) << endl
     << "(JNIEnv *__jni_env, jobject, jlong __this_nativeId)" << endl
     << INDENT << "{" << endl;
     {
@@ -727,7 +925,7 @@ void CppImplGenerator::writeCloneFunction(QTextStream &s, const AbstractMetaClas
     s << INDENT << "}" << endl << endl;
 }
 
-void CppImplGenerator::writeShellSignatures(QTextStream &s, const AbstractMetaClass *java_class) {
+void CppImplGenerator::writeShellSignatures(TextBuffer &s, const AbstractMetaClass *java_class) {
     bool has_constructors = java_class->hasConstructors();
 
     // Write the function names...
@@ -748,8 +946,8 @@ void CppImplGenerator::writeShellSignatures(QTextStream &s, const AbstractMetaCl
                 else
                     s << ",";
                 s << endl
-                << "/* " << QString("%1").arg(QString::number(pos), 3) << " */ "
-                << "\"" << function->name() << "\"";
+                << "/* " << QString("%1").arg(QString::number(pos), 3) << " */ ";
+                writeMethodString(s, java_class, function->name());
             }
             if (pos >= 0)
                 s << endl << "};" << endl << endl;
@@ -770,10 +968,8 @@ void CppImplGenerator::writeShellSignatures(QTextStream &s, const AbstractMetaCl
                 else
                     s << ",";
                 s << endl
-                << "/* " << QString("%1").arg(QString::number(pos), 3) << " */ "
-                << "\""
-                << jni_signature(function, SlashesAndStuff)
-                << "\"";
+                << "/* " << QString("%1").arg(QString::number(pos), 3) << " */ ";
+                writeMethodString(s, java_class, jni_signature(function, SlashesAndStuff));
             }
             if (pos >= 0)
                 s << endl << "};" << endl;
@@ -793,7 +989,8 @@ void CppImplGenerator::writeShellSignatures(QTextStream &s, const AbstractMetaCl
             for (int i = 0; i < inconsistents.size(); ++i) {
                 if (i != 0)
                     s << ",";
-                s << endl << INDENT << "\"" << inconsistents.at(i)->name() << "\"";
+                s << endl << INDENT;
+                writeMethodString(s, java_class, inconsistents.at(i)->name());
             }
             s << endl << "};" << endl << endl;
         }
@@ -807,9 +1004,8 @@ void CppImplGenerator::writeShellSignatures(QTextStream &s, const AbstractMetaCl
 
                 if (i != 0)
                     s << ",";
-                s << endl << INDENT << "\""
-                << jni_signature(function, SlashesAndStuff)
-                << "\"";
+                s << endl << INDENT;
+                writeMethodString(s, java_class, jni_signature(function, SlashesAndStuff));
             }
             s << endl << "};" << endl << endl;
         }
@@ -846,7 +1042,7 @@ void CppImplGenerator::writeShellSignatures(QTextStream &s, const AbstractMetaCl
     }
 }
 
-void CppImplGenerator::writeQObjectFunctions(QTextStream &s, const AbstractMetaClass *java_class) {
+void CppImplGenerator::writeQObjectFunctions(TextBuffer &s, const AbstractMetaClass *java_class) {
     s << "const QMetaObject *" << shellClassName(java_class) << "::initMetaObject(JNIEnv *env, jobject java_object)" << endl
     << "{" << endl
     << "  const QMetaObject *mo = QtDynamicMetaObject::build(env, java_object, " << java_class->qualifiedCppName() << "::metaObject()" << ");" << endl;
@@ -955,7 +1151,7 @@ void CppImplGenerator::writeQObjectFunctions(QTextStream &s, const AbstractMetaC
     << "}" << endl << endl;
 }
 
-void CppImplGenerator::writeShellConstructor(QTextStream &s, const AbstractMetaFunction *java_function, int options) {
+void CppImplGenerator::writeShellConstructor(TextBuffer &s, const AbstractMetaFunction *java_function, int options) {
     if (java_function->isModifiedRemoved(TypeSystem::ShellCode))
         return;
 
@@ -1003,7 +1199,7 @@ void CppImplGenerator::writeShellConstructor(QTextStream &s, const AbstractMetaF
     s << "}" << endl << endl;
 }
 
-void CppImplGenerator::writeShellDestructor(QTextStream &s, const AbstractMetaClass *java_class) {
+void CppImplGenerator::writeShellDestructor(TextBuffer &s, const AbstractMetaClass *java_class) {
     s << shellClassName(java_class) << "::~"
     << shellClassName(java_class) << "()" << endl
     << "{" << endl;
@@ -1116,7 +1312,7 @@ void CppImplGenerator::writeShellDestructor(QTextStream &s, const AbstractMetaCl
     s << "}" << endl << endl;
 }
 
-void CppImplGenerator::writeCodeInjections(QTextStream &s, const AbstractMetaFunction *java_function,
+void CppImplGenerator::writeCodeInjections(TextBuffer &s, const AbstractMetaFunction *java_function,
         const AbstractMetaClass *implementor, CodeSnip::Position position,
         TypeSystem::Language language) {
 
@@ -1145,7 +1341,7 @@ void CppImplGenerator::writeCodeInjections(QTextStream &s, const AbstractMetaFun
                 s << endl;
 
             QString code;
-            QTextStream tmpStream(&code);
+            TextBuffer tmpStream(&code);
             snip.formattedCode(tmpStream, INDENT);
             ArgumentMap map = snip.argumentMap;
             ArgumentMap::iterator it = map.begin();
@@ -1183,7 +1379,7 @@ static QString function_call_for_ownership(TypeSystem::Ownership owner, const QS
     }
 }
 
-void CppImplGenerator::writeOwnership(QTextStream &s,
+void CppImplGenerator::writeOwnership(TextBuffer &s,
                                       const AbstractMetaFunction *java_function,
                                       const QString &var_name,
                                       int var_index,
@@ -1220,7 +1416,7 @@ void CppImplGenerator::writeOwnership(QTextStream &s,
 
 }
 
-void CppImplGenerator::writeShellFunction(QTextStream &s, const AbstractMetaFunction *java_function,
+void CppImplGenerator::writeShellFunction(TextBuffer &s, const AbstractMetaFunction *java_function,
         const AbstractMetaClass *implementor, int id) {
     writeFunctionSignature(s, java_function, implementor, QString(), OriginalName);
 
@@ -1265,7 +1461,8 @@ void CppImplGenerator::writeShellFunction(QTextStream &s, const AbstractMetaFunc
             s << INDENT << "}" << endl;
 
             // otherwise, continue with the function call...
-            s << INDENT << "__jni_env->PushLocalFrame(100);" << endl;
+            int frameSize = shellFunctionFrameSize(java_function);
+            writePushLocalFrame(s, frameSize);
 
             if (function_type) {
                 s << INDENT;
@@ -1315,6 +1512,10 @@ void CppImplGenerator::writeShellFunction(QTextStream &s, const AbstractMetaFunc
                     s << " " << "__java_return_value = ";	// declaration only
                 }
 
+                // CallObjectMethod returns a jobject, the array has to be cast
+                if (has_function_type && new_return_type.isEmpty() && function_type->isBulkContainer())
+                    s << "(" << translateType(function_type) << ") ";
+
                 s << "__jni_env->";
                 if (new_return_type.isEmpty()) {
                     s << callXxxMethod(java_function->type());
@@ -1393,7 +1594,7 @@ void CppImplGenerator::writeShellFunction(QTextStream &s, const AbstractMetaFunc
             s << INDENT << "}" << endl;         // if(__java_return_value_object)
 
             s << INDENT << "qtjambi_exception_check(__jni_env);" << endl;
-            s << INDENT << "__jni_env->PopLocalFrame(0);" << endl;
+            writePopLocalFrame(s, frameSize);
 
             s << INDENT << "QTJAMBI_DEBUG_TRACE(\"(shell) -> leaving: "  << implementor->name()
             << "::" << java_function_signature << "\");" << endl;
@@ -1442,7 +1643,7 @@ void CppImplGenerator::writeShellFunction(QTextStream &s, const AbstractMetaFunc
 
 // ### kill implementor
 
-void CppImplGenerator::writePublicFunctionOverride(QTextStream &s,
+void CppImplGenerator::writePublicFunctionOverride(TextBuffer &s,
         const AbstractMetaFunction *java_function,
         const AbstractMetaClass *implementor) {
     Q_ASSERT(java_function->originalAttributes()
@@ -1461,7 +1662,7 @@ void CppImplGenerator::writePublicFunctionOverride(QTextStream &s,
 }
 
 
-void CppImplGenerator::writeVirtualFunctionOverride(QTextStream &s,
+void CppImplGenerator::writeVirtualFunctionOverride(TextBuffer &s,
         const AbstractMetaFunction *java_function,
         const AbstractMetaClass *implementor) {
     Q_ASSERT(!java_function->isFinalInCpp());
@@ -1492,7 +1693,7 @@ void CppImplGenerator::writeVirtualFunctionOverride(QTextStream &s,
 }
 
 
-bool CppImplGenerator::writeBaseClassFunctionCall(QTextStream &s,
+bool CppImplGenerator::writeBaseClassFunctionCall(TextBuffer &s,
         const AbstractMetaFunction *java_function,
         const AbstractMetaClass *,
         Option options) {
@@ -1523,22 +1724,19 @@ bool CppImplGenerator::writeBaseClassFunctionCall(QTextStream &s,
 }
 
 
-void CppImplGenerator::writeFunctionName(QTextStream &s,
-        const AbstractMetaFunction *java_function,
-        const AbstractMetaClass *java_class,
-        uint options) {
-    const AbstractMetaClass *cls = java_class ? java_class : java_function->ownerClass();
-    AbstractMetaArgumentList arguments = java_function->arguments();
-
-    // Function signature
-    QString return_type = jniReturnName(java_function);
-    QString function_name;
+static QString jni_function_name(const AbstractMetaFunction *java_function) {
+    return java_function->needsCallThrough()
+           ? java_function->marshalledName()
+           : java_function->name();
+}
 
+/**
+ * Returns the mangled argument part of the JNI name of \a java_function,
+ * starting with the "__" separator.
+ */
+static QString jni_mangled_arguments(const AbstractMetaFunction *java_function) {
+    AbstractMetaArgumentList arguments = java_function->arguments();
     bool callThrough = java_function->needsCallThrough();
-    if (!callThrough)
-        function_name = java_function->name();
-    else
-        function_name = java_function->marshalledName();
 
     QString args = "__";
 
@@ -1561,12 +1759,159 @@ void CppImplGenerator::writeFunctionName(QTextStream &s,
         }
     }
 
-    s << jni_function_signature(cls->package(), cls->name(), function_name,
-                                return_type, args, options);
+    return args;
+}
+
+/**
+ * Turns mangled JNI arguments back into the parameter descriptor they
+ * were made from, "Ljava_lang_String_2_3I" into "Ljava/lang/String;[I".
+ */
+static QString jni_descriptor_from_mangled(const QString &mangled) {
+    QString descriptor;
+    for (int i = 0; i < mangled.size(); ++i) {
+        QChar c = mangled.at(i);
+        if (c != QLatin1Char('_') || i + 1 == mangled.size()) {
+            descriptor += c;
+            continue;
+        }
+
+        QChar escape = mangled.at(++i);
+        if (escape == QLatin1Char('1')) {
+            descriptor += QLatin1Char('_');
+        } else if (escape == QLatin1Char('2')) {
+            descriptor += QLatin1Char(';');
+        } else if (escape == QLatin1Char('3')) {
+            descriptor += QLatin1Char('[');
+        } else if (escape == QLatin1Char('0')) {
+            descriptor += QChar(mangled.mid(i + 1, 4).toUShort(0, 16));
+            i += 4;
+        } else {
+            descriptor += QLatin1Char('/');
+            --i;
+        }
+    }
+    return descriptor;
+}
+
+/**
+ * Returns the return type descriptor of the Java native method that
+ * JavaGenerator declares for \a java_function.
+ */
+static QString jni_native_return_signature(const AbstractMetaFunction *java_function) {
+    if (java_function->isConstructor())
+        return "V";
+
+    QString modified_type = java_function->typeReplaced(0);
+    if (modified_type == "void")
+        return "V";
+    if (!modified_type.isEmpty())
+        return jni_signature(modified_type, SlashesAndStuff);
+
+    if (java_function->hasFlattenedReturnType())
+        return "J";
+
+    const AbstractMetaType *type = java_function->type();
+    if (type != 0 && (type->isEnum() || type->isFlags()))
+        return "I";
+    return jni_signature(type, SlashesAndStuff);
+}
+
+void CppImplGenerator::writeFunctionName(TextBuffer &s,
+        const AbstractMetaFunction *java_function,
+        const AbstractMetaClass *java_class,
+        uint options) {
+    const AbstractMetaClass *cls = java_class ? java_class : java_function->ownerClass();
+
+    s << jni_function_signature(cls->package(), cls->name(), jni_function_name(java_function),
+                                jniReturnName(java_function), jni_mangled_arguments(java_function),
+                                options);
+}
+
+/**
+ * Returns the head of the JNI function \a function_name of \a java_class,
+ * exported for lookup by name or, with registerNatives(), static and
+ * queued for the class's JNINativeMethod table. \a signature is the
+ * descriptor of the Java native method.
+ */
+QString CppImplGenerator::nativeFunction(const AbstractMetaClass *java_class,
+        const QString &function_name,
+        const QString &return_type,
+        const QString &signature,
+        const QString &mangled_arguments) {
+    if (!registerNatives()) {
+        return jni_function_signature(java_class->package(), java_class->name(), function_name,
+                                      return_type, mangled_arguments);
+    }
+
+    NativeMethod method;
+    method.java_class = QString(java_class->fullName()).replace('.', '/');
+    method.name = function_name;
+    method.signature = signature;
+    method.function = jni_function_signature(java_class->package(), java_class->name(), function_name,
+                      return_type, mangled_arguments, 0);
+    m_native_methods << method;
+
+    return jni_function_signature(java_class->package(), java_class->name(), function_name,
+                                  return_type, mangled_arguments, ReturnType | Registered);
+}
+
+QString CppImplGenerator::nativeFunction(const AbstractMetaFunction *java_function,
+        const AbstractMetaClass *java_class) {
+    const AbstractMetaClass *cls = java_class ? java_class : java_function->ownerClass();
+    QString args = jni_mangled_arguments(java_function);
+
+    return nativeFunction(cls, jni_function_name(java_function), jniReturnName(java_function),
+                          "(" + jni_descriptor_from_mangled(args.mid(2)) + ")"
+                          + jni_native_return_signature(java_function),
+                          args);
+}
+
+QString CppImplGenerator::registerNativesFunctionName(const AbstractMetaClass *java_class) {
+    return "__qt_register_natives_" + QString(java_class->package()).replace(".", "_")
+           + "_" + java_class->name();
+}
+
+QString CppImplGenerator::registerNativesHelperName(const QString &package) {
+    return "__qt_register_natives_" + QString(package).replace(".", "_");
+}
+
+/**
+ * Writes the JNINativeMethod table of the functions nativeFunction()
+ * queued for \a java_class and the function that registers it, which the
+ * package's library initializer calls.
+ */
+void CppImplGenerator::writeRegisterNatives(TextBuffer &s, const AbstractMetaClass *java_class) {
+    QMap<QString, QList<NativeMethod> > classes;
+    foreach(const NativeMethod &method, m_native_methods)
+        classes[method.java_class] << method;
+
+    int table = 0;
+    for (QMap<QString, QList<NativeMethod> >::const_iterator it = classes.constBegin();
+            it != classes.constEnd(); ++it, ++table) {
+        s << "static JNINativeMethod __qt_native_methods_" << table << "[] = {" << endl;
+        foreach(const NativeMethod &method, it.value()) {
+            s << "    { (char *) \"" << method.name << "\", (char *) \"" << method.signature
+            << "\", (void *) " << method.function << " }," << endl;
+        }
+        s << "};" << endl << endl;
+    }
+
+    s << "void " << registerNativesFunctionName(java_class) << "(JNIEnv *__jni_env)" << endl
+    << "{" << endl;
+    table = 0;
+    for (QMap<QString, QList<NativeMethod> >::const_iterator it = classes.constBegin();
+            it != classes.constEnd(); ++it, ++table) {
+        s << "    " << registerNativesHelperName(java_class->package()) << "(__jni_env, \""
+        << it.key() << "\", __qt_native_methods_" << table << ", " << it.value().size() << ");" << endl;
+    }
+    if (classes.isEmpty())
+        s << "    Q_UNUSED(__jni_env);" << endl;
+    s << "}" << endl << endl;
 
+    m_native_methods.clear();
 }
 
-void CppImplGenerator::writeFinalFunctionArguments(QTextStream &s, const AbstractMetaFunction *java_function,
+void CppImplGenerator::writeFinalFunctionArguments(TextBuffer &s, const AbstractMetaFunction *java_function,
         const QString &java_object_name) {
     bool callThrough = java_function->needsCallThrough();
 
@@ -1604,7 +1949,7 @@ void CppImplGenerator::writeFinalFunctionArguments(QTextStream &s, const Abstrac
     Generates type conversion from Java -> Qt for all the arguments
     that are to be to be passed to the function
 */
-void CppImplGenerator::writeFinalFunctionSetup(QTextStream &s, const AbstractMetaFunction *java_function,
+void CppImplGenerator::writeFinalFunctionSetup(TextBuffer &s, const AbstractMetaFunction *java_function,
         const QString &qt_object_name,
         const AbstractMetaClass *cls) {
     // Translate each of the function arguments into qt types
@@ -1635,7 +1980,52 @@ void CppImplGenerator::writeFinalFunctionSetup(QTextStream &s, const AbstractMet
 }
 
 
-void CppImplGenerator::writeFinalFunction(QTextStream &s, const AbstractMetaFunction *java_function,
+/*!
+    Returns true if \a java_function is a leaf call that only passes
+    primitives in and out, e.g. QRect::width() or QPoint::setX(int).
+    Such functions need no conversions, no ownership handling and no
+    virtual dispatch, so their native wrapper can be reduced to a direct
+    call.
+*/
+static bool is_leaf_function(const AbstractMetaFunction *java_function, const AbstractMetaClass *cls) {
+    if (java_function->isConstructor()
+            || java_function->isSignal()
+            || java_function->isInGlobalScope()
+            || !java_function->needsCallThrough())
+        return false;
+
+    if (java_function->type() != 0 && !java_function->type()->isPrimitive())
+        return false;
+
+    foreach(const AbstractMetaArgument *argument, java_function->arguments()) {
+        if (!argument->type()->isPrimitive())
+            return false;
+    }
+
+    // Virtual calls go through __override_ and need the link to decide
+    if (!java_function->isFinalOverload()
+            && !java_function->isFinalInCpp()
+            && !java_function->isStatic()
+            && cls->generateShellClass())
+        return false;
+
+    // Any modification may inject code, replace types or change ownership
+    const AbstractMetaClass *implementor = java_function->implementingClass();
+    while (implementor != 0) {
+        foreach(const FunctionModification &mod, java_function->modifications(implementor)) {
+            if (!mod.snips.isEmpty() || !mod.argument_mods.isEmpty())
+                return false;
+        }
+
+        if (implementor == implementor->baseClass())
+            break;
+        implementor = implementor->baseClass();
+    }
+
+    return true;
+}
+
+void CppImplGenerator::writeFinalFunction(TextBuffer &s, const AbstractMetaFunction *java_function,
         const AbstractMetaClass *java_class) {
     Q_ASSERT(java_class);
 
@@ -1662,13 +2052,27 @@ void CppImplGenerator::writeFinalFunction(QTextStream &s, const AbstractMetaFunc
 
     // function signature...
     bool callThrough = java_function->needsCallThrough();
-    uint options = m_native_jump_table ? ReturnType | ExternC : StandardJNISignature;
-    writeFunctionName(s, java_function, cls, options);
+    if (m_native_jump_table)
+        writeFunctionName(s, java_function, cls, ReturnType | ExternC);
+    else
+        s << nativeFunction(java_function, cls);
     s << endl;
     writeFinalFunctionArguments(s, java_function, java_object_name);
     s << "{" << endl;
     Indentation indent(INDENT);
 
+    bool protected_in_final = cls->isFinal()
+                              && (!java_function->isAbstract() || !java_function->isFinalInTargetLang())
+                              && !java_function->wasPublic();
+
+    // Leaf functions are called at high frequency (geometry getters and
+    // setters), so skip tracing and exception checks unless debugging.
+    if (!protected_in_final && !qtJambiDebugTools() && is_leaf_function(java_function, cls)) {
+        writeLeafFunctionBody(s, java_function, cls, qt_object_name);
+        s << "}" << endl << endl;
+        return;
+    }
+
     s << INDENT << "QTJAMBI_DEBUG_TRACE(\"(native) entering: " << java_function_signature << "\");" << endl;
 
     // Avoid compiler warnings when the variables are unused
@@ -1683,7 +2087,7 @@ void CppImplGenerator::writeFinalFunction(QTextStream &s, const AbstractMetaFunc
             s << INDENT << "Q_UNUSED(__this_nativeId)" << endl;
     }
 
-    if (cls->isFinal() && (!java_function->isAbstract() || !java_function->isFinalInTargetLang()) && !java_function->wasPublic()) {
+    if (protected_in_final) {
         QString debug = QString("protected function '%1' in final class '%2'")
                         .arg(java_function->signature()).arg(java_class->name());
         ReportHandler::warning(debug);
@@ -1742,8 +2146,11 @@ void CppImplGenerator::writeFinalFunction(QTextStream &s, const AbstractMetaFunc
                                   extra_param);
                 s << endl;
 
-                writeQtToJava(s, function_type, qt_return_value, java_return_value,
-                              java_function, 0, EnumAsInts);
+                if (java_function->hasFlattenedReturnType())
+                    writeFlattenedValue(s, function_type, qt_return_value, java_return_value);
+                else
+                    writeQtToJava(s, function_type, qt_return_value, java_return_value,
+                                  java_function, 0, EnumAsInts);
 
                 s << INDENT << "QTJAMBI_DEBUG_TRACE(\"(native) -> leaving: "
                 << java_function_signature << "\");" << endl;
@@ -1767,7 +2174,48 @@ void CppImplGenerator::writeFinalFunction(QTextStream &s, const AbstractMetaFunc
     s << endl << endl;
 }
 
-void CppImplGenerator::writeAssignment(QTextStream &s, const QString &destName, const QString &srcName,
+void CppImplGenerator::writeLeafFunctionBody(TextBuffer &s, const AbstractMetaFunction *java_function,
+        const AbstractMetaClass *cls, const QString &qt_object_name) {
+    s << INDENT << "Q_UNUSED(__jni_env)" << endl;
+
+    if (!java_function->isStatic()) {
+        QString className = java_function->isFinalOverload() ? cls->name() : shellClassName(cls);
+        s << INDENT << className << " *" << qt_object_name
+        << " = (" << className << " *) qtjambi_from_jlong(__this_nativeId);" << endl
+        << INDENT << "Q_ASSERT(" << qt_object_name << ");" << endl;
+    }
+
+    QString function_prefix;
+    Option option = NoOption;
+    if (java_function->isFinalOverload())
+        ; // no prefix
+    else if (java_function->isFinalInCpp() && !java_function->wasPublic() && cls->generateShellClass())
+        function_prefix = "__public_";
+    else
+        option = OriginalName;
+
+    s << INDENT;
+    if (java_function->type() != 0)
+        s << "return (" << translateType(java_function->type()) << ") ";
+    writeFunctionCall(s, qt_object_name, java_function, function_prefix, option);
+}
+
+/*!
+    Packs the flattened fields of the value \a qt_name into the jlong
+    \a java_name, first field in the high word. JavaGenerator unpacks
+    them in the same order and constructs the Java object itself.
+*/
+void CppImplGenerator::writeFlattenedValue(TextBuffer &s, const AbstractMetaType *java_type,
+        const QString &qt_name, const QString &java_name) {
+    QStringList fields = static_cast<const ValueTypeEntry *>(java_type->typeEntry())->flattenedFields();
+
+    s << INDENT << "jlong " << java_name << " = (jlong) (";
+    if (fields.size() == 2)
+        s << "((quint64) (quint32) " << qt_name << "." << fields.at(0) << "() << 32) | ";
+    s << "(quint32) " << qt_name << "." << fields.last() << "());" << endl;
+}
+
+void CppImplGenerator::writeAssignment(TextBuffer &s, const QString &destName, const QString &srcName,
                                        const AbstractMetaType *java_type) {
     if (java_type->isArray()) {
         for (int i = 0; i < java_type->arrayElementCount(); ++i) {
@@ -1779,7 +2227,7 @@ void CppImplGenerator::writeAssignment(QTextStream &s, const QString &destName,
     }
 }
 
-void CppImplGenerator::writeFieldAccessors(QTextStream &s, const AbstractMetaField *java_field) {
+void CppImplGenerator::writeFieldAccessors(TextBuffer &s, const AbstractMetaField *java_field) {
     Q_ASSERT(java_field);
     Q_ASSERT(java_field->isPublic() || java_field->isProtected());
 
@@ -1810,8 +2258,7 @@ void CppImplGenerator::writeFieldAccessors(QTextStream &s, const AbstractMetaFie
             s << "}" << endl << endl;
         }
 
-        writeFunctionName(s, setter, setter->ownerClass());
-        s << endl;
+        s << nativeFunction(setter, setter->ownerClass()) << endl;
         writeFinalFunctionArguments(s, setter, "__java_object");
         s  << "{" << endl;
 
@@ -1859,8 +2306,7 @@ void CppImplGenerator::writeFieldAccessors(QTextStream &s, const AbstractMetaFie
         }
 
 
-        writeFunctionName(s, getter, getter->ownerClass());
-        s << endl;
+        s << nativeFunction(getter, getter->ownerClass()) << endl;
         writeFinalFunctionArguments(s, getter, "__java_object");
         s << "{" << endl;
         {
@@ -1891,14 +2337,17 @@ void CppImplGenerator::writeFieldAccessors(QTextStream &s, const AbstractMetaFie
                 qt_return_value += getter->name() + "_getter()";
             s << qt_return_value << ";" << endl;
 
-            writeQtToJava(s, getter->type(), tmp_name, java_return_value, 0, -1, EnumAsInts);
+            if (getter->hasFlattenedReturnType())
+                writeFlattenedValue(s, getter->type(), tmp_name, java_return_value);
+            else
+                writeQtToJava(s, getter->type(), tmp_name, java_return_value, 0, -1, EnumAsInts);
             s << INDENT << "return " << java_return_value << ";" << endl;
         }
         s << "}" << endl << endl;
     }
 }
 
-void CppImplGenerator::writeFinalDestructor(QTextStream &s, const AbstractMetaClass *cls) {
+void CppImplGenerator::writeFinalDestructor(TextBuffer &s, const AbstractMetaClass *cls) {
     if (cls->hasConstructors()) {
         s << INDENT << "static void qtjambi_destructor(void *ptr)" << endl
         << INDENT << "{" << endl;
@@ -1929,7 +2378,7 @@ void CppImplGenerator::writeFinalDestructor(QTextStream &s, const AbstractMetaCl
     }
 }
 
-void CppImplGenerator::writeFinalConstructor(QTextStream &s,
+void CppImplGenerator::writeFinalConstructor(TextBuffer &s,
         const AbstractMetaFunction *java_function,
         const QString &qt_object_name,
         const QString &java_object_name) {
@@ -2061,13 +2510,13 @@ void CppImplGenerator::writeFinalConstructor(QTextStream &s,
     s << space << ");" << endl;
 }
 
-void CppImplGenerator::writeSignalInitialization(QTextStream &s, const AbstractMetaClass *java_class) {
+void CppImplGenerator::writeSignalInitialization(TextBuffer &s, const AbstractMetaClass *java_class) {
     if (!java_class->isQObject()
             || java_class->cppSignalFunctions().size() == 0) {
         return ;
     }
 
-    s << jni_function_signature(java_class->package(), java_class->name(), "__qt_signalInitialization", "jboolean")
+    s << nativeFunction(java_class, "__qt_signalInitialization", "jboolean", "(JLjava/lang/String;)Z")
     << endl << "(JNIEnv *__jni_env, jobject java_object, jlong ptr, jstring java_signal_name)" << endl
     << "{" << endl
     << "   QtJambiLink *link = (QtJambiLink *) ptr;" << endl
@@ -2143,13 +2592,10 @@ QString CppImplGenerator::fromObject(const TypeEntry *entry,
     return returned;
 }
 
-void CppImplGenerator::writeOriginalMetaObjectFunction(QTextStream &s, const AbstractMetaClass *java_class) {
+void CppImplGenerator::writeOriginalMetaObjectFunction(TextBuffer &s, const AbstractMetaClass *java_class) {
     Q_ASSERT(java_class->isQObject());
 
-    s << jni_function_signature(java_class->package(),
-                                java_class->name(),
-                                "originalMetaObject",
-                                "jlong");
+    s << nativeFunction(java_class, "originalMetaObject", "jlong", "()J");
 
     s << endl
     << "(JNIEnv *," << endl
@@ -2162,11 +2608,10 @@ void CppImplGenerator::writeOriginalMetaObjectFunction(QTextStream &s, const Abs
     s << "}" << endl << endl;
 }
 
-void CppImplGenerator::writeFromNativeFunction(QTextStream &s, const AbstractMetaClass *java_class) {
-    s << jni_function_signature(java_class->package(),
-                                java_class->name(),
-                                "fromNativePointer",
-                                "jobject");
+void CppImplGenerator::writeFromNativeFunction(TextBuffer &s, const AbstractMetaClass *java_class) {
+    s << nativeFunction(java_class, "fromNativePointer", "jobject",
+                        "(Lcom/trolltech/qt/QNativePointer;)"
+                        + jni_signature(java_class->fullName(), SlashesAndStuff));
     s << endl
     << "(JNIEnv *__jni_env," << endl
     << " jclass," << endl
@@ -2180,11 +2625,10 @@ void CppImplGenerator::writeFromNativeFunction(QTextStream &s, const AbstractMet
     }
 }
 
-void CppImplGenerator::writeFromArrayFunction(QTextStream &s, const AbstractMetaClass *java_class) {
-    s << jni_function_signature(java_class->package(),
-                                java_class->name(),
-                                "nativePointerArray",
-                                "jobject");
+void CppImplGenerator::writeFromArrayFunction(TextBuffer &s, const AbstractMetaClass *java_class) {
+    s << nativeFunction(java_class, "nativePointerArray", "jobject",
+                        "([" + jni_signature(java_class->fullName(), SlashesAndStuff)
+                        + ")Lcom/trolltech/qt/QNativePointer;");
     s << endl
     << "(JNIEnv *__jni_env," << endl
     << " jclass," << endl
@@ -2201,7 +2645,7 @@ void CppImplGenerator::writeFromArrayFunction(QTextStream &s, const AbstractMeta
 }
 
 
-void CppImplGenerator::writeInterfaceCastFunction(QTextStream &s,
+void CppImplGenerator::writeInterfaceCastFunction(TextBuffer &s,
         const AbstractMetaClass *java_class,
         const AbstractMetaClass *interface) {
     Q_ASSERT(interface->isInterface());
@@ -2209,11 +2653,7 @@ void CppImplGenerator::writeInterfaceCastFunction(QTextStream &s,
     QString interface_name = ie->origin()->targetLangName();
 
     s << endl
-    << jni_function_signature(java_class->package(),
-                              java_class->name(),
-                              QString("__qt_cast_to_%1").arg(interface_name),
-                              "jlong",
-                              "__J");
+    << nativeFunction(java_class, QString("__qt_cast_to_%1").arg(interface_name), "jlong", "(J)J", "__J");
 
     s << endl
     << "(JNIEnv *," << endl
@@ -2225,7 +2665,7 @@ void CppImplGenerator::writeInterfaceCastFunction(QTextStream &s,
                 << "}" << endl;
 }
 
-bool CppImplGenerator::writeConversionRule(QTextStream &s,
+bool CppImplGenerator::writeConversionRule(TextBuffer &s,
         TypeSystem::Language target_language,
         const AbstractMetaFunction *java_function,
         int argument_index,
@@ -2270,7 +2710,7 @@ bool CppImplGenerator::writeConversionRule(QTextStream &s,
 }
 
 
-void CppImplGenerator::writeJavaToQt(QTextStream &s,
+void CppImplGenerator::writeJavaToQt(TextBuffer &s,
                                      const AbstractMetaClass *java_class,
                                      const AbstractMetaType *function_return_type,
                                      const QString &qt_name,
@@ -2297,7 +2737,7 @@ void CppImplGenerator::writeJavaToQt(QTextStream &s,
 }
 
 
-void CppImplGenerator::writeJavaToQt(QTextStream &s,
+void CppImplGenerator::writeJavaToQt(TextBuffer &s,
                                      const AbstractMetaType *java_type,
                                      const QString &qt_name,
                                      const QString &java_name,
@@ -2353,8 +2793,26 @@ void CppImplGenerator::writeJavaToQt(QTextStream &s,
         }
 
     } else if (java_type->isTargetLangString()) {
-        s << INDENT << "QString " << qt_name
-        << " =  qtjambi_to_qstring(__jni_env, (jstring) " << java_name << ");" << endl;
+        TypeSystem::StringConversion conversion = java_function != 0
+                ? java_function->stringConversion(argument_index)
+                : TypeSystem::DefaultStringConversion;
+
+        if (conversion == TypeSystem::DefaultStringConversion) {
+            s << INDENT << "QString " << qt_name
+            << " =  qtjambi_to_qstring(__jni_env, (jstring) " << java_name << ");" << endl;
+        } else {
+            // Copy the characters straight into the QString's buffer
+            s << INDENT << "QString " << qt_name << ";" << endl
+            << INDENT << "if (" << java_name << " != 0) {" << endl;
+            {
+                Indentation indent(INDENT);
+                s << INDENT << "jsize __qt_length = __jni_env->GetStringLength((jstring) " << java_name << ");" << endl
+                << INDENT << qt_name << ".resize(__qt_length);" << endl
+                << INDENT << "__jni_env->GetStringRegion((jstring) " << java_name << ", 0, __qt_length, "
+                << "(jchar *) " << qt_name << ".data());" << endl;
+            }
+            s << INDENT << "}" << endl;
+        }
 
     } else if (java_type->isTargetLangStringRef()) {
         s << INDENT << "QString " << qt_name << "_s"
@@ -2576,7 +3034,7 @@ static const QString nativePointerTypeString(const AbstractMetaType *java_type)
     return QString("%1").arg(type);
 }
 
-void CppImplGenerator::writeQtToJava(QTextStream &s,
+void CppImplGenerator::writeQtToJava(TextBuffer &s,
                                      const AbstractMetaType *java_type,
                                      const QString &qt_name,
                                      const QString &java_name,
@@ -2646,8 +3104,44 @@ void CppImplGenerator::writeQtToJava(QTextStream &s,
         << qt_name << ");" << endl;
 
     } else if (java_type->isTargetLangString()) {
-        s << INDENT << "jstring " << java_name << " = qtjambi_from_qstring(__jni_env, "
-        << qt_name << ");" << endl;
+        TypeSystem::StringConversion conversion = java_function != 0
+                ? java_function->stringConversion(argument_index)
+                : TypeSystem::DefaultStringConversion;
+
+        if (conversion == TypeSystem::DirectStringConversion) {
+            s << INDENT << "jstring " << java_name << " = __jni_env->NewString((const jchar *) "
+            << qt_name << ".constData(), " << qt_name << ".length());" << endl;
+
+        } else if (conversion == TypeSystem::AsciiStringConversion) {
+            // Short ASCII strings are narrowed on the stack and created
+            // through NewStringUTF(), anything else goes through NewString()
+            s << INDENT << "jstring " << java_name << ";" << endl
+            << INDENT << "{" << endl;
+            {
+                Indentation indent(INDENT);
+                s << INDENT << "const ushort *__qt_chars = " << qt_name << ".utf16();" << endl
+                << INDENT << "int __qt_length = " << qt_name << ".length();" << endl
+                << INDENT << "char __qt_buffer[256];" << endl
+                << INDENT << "int __qt_ascii = 0;" << endl
+                << INDENT << "if (__qt_length < int(sizeof(__qt_buffer))) {" << endl
+                << INDENT << "    while (__qt_ascii < __qt_length && __qt_chars[__qt_ascii] != 0 && __qt_chars[__qt_ascii] < 0x80) {" << endl
+                << INDENT << "        __qt_buffer[__qt_ascii] = char(__qt_chars[__qt_ascii]);" << endl
+                << INDENT << "        ++__qt_ascii;" << endl
+                << INDENT << "    }" << endl
+                << INDENT << "}" << endl
+                << INDENT << "if (__qt_ascii == __qt_length) {" << endl
+                << INDENT << "    __qt_buffer[__qt_length] = 0;" << endl
+                << INDENT << "    " << java_name << " = __jni_env->NewStringUTF(__qt_buffer);" << endl
+                << INDENT << "} else {" << endl
+                << INDENT << "    " << java_name << " = __jni_env->NewString((const jchar *) __qt_chars, __qt_length);" << endl
+                << INDENT << "}" << endl;
+            }
+            s << INDENT << "}" << endl;
+
+        } else {
+            s << INDENT << "jstring " << java_name << " = qtjambi_from_qstring(__jni_env, "
+            << qt_name << ");" << endl;
+        }
 
     } else if (java_type->isTargetLangStringRef()) {
         s << INDENT << "jstring " << java_name << " = qtjambi_from_qstringref(__jni_env, "
@@ -2671,19 +3165,17 @@ void CppImplGenerator::writeQtToJava(QTextStream &s,
             s << INDENT << "int " << java_name << " = " << qt_name << ";" << endl;
         }
 
-    } else if (java_type->isTargetLangEnum()) {
+    } else if (java_type->isTargetLangEnum() || java_type->isTargetLangFlags()) {
         Q_ASSERT((option & EnumAsInts) == 0);
-        const EnumTypeEntry *et = static_cast<const EnumTypeEntry *>(java_type->typeEntry());
-        s << INDENT << "jobject " << java_name << " = qtjambi_from_enum(__jni_env, "
-        << qt_name << ", \"" << et->javaPackage().replace('.', '/') << '/'
-        << et->javaQualifier() << '$' << et->targetLangName() << "\");" << endl;
-
-    } else if (java_type->isTargetLangFlags()) {
-        Q_ASSERT((option & EnumAsInts) == 0);
-        const FlagsTypeEntry *ft = static_cast<const FlagsTypeEntry *>(java_type->typeEntry());
-        s << INDENT << "jobject " << java_name << " = qtjambi_from_flags(__jni_env, "
-        << qt_name << ", \"" << ft->javaPackage().replace('.', '/') << '/'
-        << ft->originator()->javaQualifier() << '$' << ft->targetLangName() << "\");" << endl;
+        const TypeEntry *entry = java_type->typeEntry();
+        s << INDENT << "jobject " << java_name << " = ";
+        if (classHandleTable()) {
+            s << "qtjambi_from_class_handle(__jni_env, " << qt_name << ", "
+            << classHandleName(entry) << ");" << endl;
+        } else {
+            s << (entry->isFlags() ? "qtjambi_from_flags" : "qtjambi_from_enum")
+            << "(__jni_env, " << qt_name << ", \"" << classHandleJavaName(entry) << "\");" << endl;
+        }
 
     } else if (java_type->isContainer()) {
         writeQtToJavaContainer(s, java_type, qt_name, java_name, 0, -1);
@@ -2737,7 +3229,7 @@ void CppImplGenerator::writeQtToJava(QTextStream &s,
 }
 
 
-void CppImplGenerator::writeQtToJavaContainer(QTextStream &s,
+void CppImplGenerator::writeQtToJavaContainer(TextBuffer &s,
         const AbstractMetaType *java_type,
         const QString &qt_name,
         const QString &java_name,
@@ -2763,7 +3255,40 @@ void CppImplGenerator::writeQtToJavaContainer(QTextStream &s,
     const ContainerTypeEntry *type =
         static_cast<const ContainerTypeEntry *>(java_type->typeEntry());
 
-    if (type->type() == ContainerTypeEntry::ListContainer
+    if (java_type->isBulkContainer()) {
+        const TypeEntry *element = java_type->instantiations().first()->typeEntry();
+        QString elements_name = java_name + "_elements";
+        QString iteratorEndName = "__qt_" + QString(qt_name).replace('.', '_') + "_end_it";
+        QString iteratorName = "__qt_" + QString(qt_name).replace('.', '_') + "_it";
+
+        // Running out of memory leaves an exception pending for the caller
+        s << endl
+        << INDENT << translateType(java_type) << " " << java_name << " = __jni_env->New"
+        << bulk_array_type(element) << "Array(" << qt_name << ".size());" << endl
+        << INDENT << element->jniName() << " *" << elements_name << " = " << java_name << " != 0" << endl
+        << INDENT << "    ? (" << element->jniName() << " *) __jni_env->GetPrimitiveArrayCritical("
+        << java_name << ", 0)" << endl
+        << INDENT << "    : 0;" << endl
+        << INDENT << "if (" << elements_name << " != 0) {" << endl;
+        {
+            Indentation indent(INDENT);
+            s << INDENT << element->jniName() << " *" << elements_name << "_it = " << elements_name
+            << ";" << endl
+            << INDENT;
+            writeTypeInfo(s, java_type, ForceValueType);
+            s << "::const_iterator " << iteratorEndName << " = " << qt_name << ".constEnd();" << endl
+            << INDENT << "for (";
+            writeTypeInfo(s, java_type, ForceValueType);
+            s << "::const_iterator " << iteratorName << " = " << qt_name << ".constBegin(); "
+            << iteratorName << " != " << iteratorEndName << "; ++" << iteratorName << ")" << endl
+            << INDENT << "    *" << elements_name << "_it++ = (" << element->jniName() << ") *"
+            << iteratorName << ";" << endl
+            << INDENT << "__jni_env->ReleasePrimitiveArrayCritical(" << java_name << ", "
+            << elements_name << ", 0);" << endl;
+        }
+        s << INDENT << "}" << endl;
+
+    } else if (type->type() == ContainerTypeEntry::ListContainer
             || type->type() == ContainerTypeEntry::VectorContainer
             || type->type() == ContainerTypeEntry::StringListContainer
             || type->type() == ContainerTypeEntry::LinkedListContainer
@@ -2915,7 +3440,7 @@ void CppImplGenerator::writeQtToJavaContainer(QTextStream &s,
 }
 
 
-void CppImplGenerator::writeJavaToQtContainer(QTextStream &s,
+void CppImplGenerator::writeJavaToQtContainer(TextBuffer &s,
         const AbstractMetaType *java_type,
         const QString &qt_name,
         const QString &java_name,
@@ -2942,7 +3467,37 @@ void CppImplGenerator::writeJavaToQtContainer(QTextStream &s,
     const ContainerTypeEntry *type =
         static_cast<const ContainerTypeEntry *>(java_type->typeEntry());
 
-    if (type->type() == ContainerTypeEntry::ListContainer
+    if (java_type->isBulkContainer()) {
+        const TypeEntry *element = java_type->instantiations().first()->typeEntry();
+        QString java_array = "(" + translateType(java_type) + ") " + java_name;
+
+        s << INDENT;
+        writeTypeInfo(s, java_type, ForceValueType);
+        s << qt_name << ";" << endl;
+
+        s << INDENT << "if (" << java_name << " != 0) {" << endl;
+        {
+            Indentation indent(INDENT);
+            s << INDENT << "jsize __qt__size = __jni_env->GetArrayLength(" << java_array << ");" << endl;
+
+            if (type->type() == ContainerTypeEntry::VectorContainer
+                    || type->type() == ContainerTypeEntry::StackContainer)
+                s << INDENT << qt_name << ".reserve(__qt__size);" << endl;
+
+            // Running out of memory leaves an exception pending and the
+            // container empty
+            s << INDENT << element->jniName() << " *__qt__elements = (" << element->jniName()
+            << " *) __jni_env->GetPrimitiveArrayCritical(" << java_array << ", 0);" << endl
+            << INDENT << "if (__qt__elements != 0) {" << endl
+            << INDENT << "    for (int i=0; i<__qt__size; ++i)" << endl
+            << INDENT << "        " << qt_name << " << (" << element->qualifiedCppName()
+            << ") __qt__elements[i];" << endl
+            << INDENT << "    __jni_env->ReleasePrimitiveArrayCritical(" << java_array
+            << ", __qt__elements, JNI_ABORT);" << endl
+            << INDENT << "}" << endl;
+        }
+        s << INDENT << "}" << endl;
+    } else if (type->type() == ContainerTypeEntry::ListContainer
             || type->type() == ContainerTypeEntry::VectorContainer
             || type->type() == ContainerTypeEntry::StringListContainer
             || type->type() == ContainerTypeEntry::LinkedListContainer
@@ -3048,7 +3603,7 @@ void CppImplGenerator::writeJavaToQtContainer(QTextStream &s,
 }
 
 
-void CppImplGenerator::writeFunctionCall(QTextStream &s, const QString &object_name,
+void CppImplGenerator::writeFunctionCall(TextBuffer &s, const QString &object_name,
         const AbstractMetaFunction *java_function,
         const QString &prefix,
         Option option,
@@ -3105,7 +3660,7 @@ void CppImplGenerator::writeFunctionCall(QTextStream &s, const QString &object_n
 }
 
 
-void CppImplGenerator::writeFunctionCallArguments(QTextStream &s,
+void CppImplGenerator::writeFunctionCallArguments(TextBuffer &s,
         const AbstractMetaFunction *java_function,
         const QString &prefix,
         Option options) {
@@ -3170,6 +3725,8 @@ QString CppImplGenerator::translateType(const AbstractMetaType *java_type, Optio
             || java_type->isTargetLangChar()
             || java_type->isArray()) {
         return java_type->typeEntry()->jniName();
+    } else if (java_type->isBulkContainer()) {
+        return java_type->instantiations().first()->typeEntry()->jniName() + "Array";
     } else if (java_type->isIntegerEnum() || java_type->isIntegerFlags()
                || ((option & EnumAsInts) && (java_type->isEnum() || java_type->isFlags()))) {
         return "jint";
@@ -3178,7 +3735,7 @@ QString CppImplGenerator::translateType(const AbstractMetaType *java_type, Optio
     }
 }
 
-void CppImplGenerator::writeExtraIncludes(QTextStream &s, const AbstractMetaClass *java_class) {
+void CppImplGenerator::writeExtraIncludes(TextBuffer &s, const AbstractMetaClass *java_class) {
     IncludeList includes = java_class->typeEntry()->extraIncludes();
     qSort(includes.begin(), includes.end());
 
@@ -3207,7 +3764,7 @@ void CppImplGenerator::writeDefaultConstructedValues_helper(QSet<QString> &value
 }
 
 
-void CppImplGenerator::writeDefaultConstructedValues(QTextStream &s, const AbstractMetaClass *java_class) {
+void CppImplGenerator::writeDefaultConstructedValues(TextBuffer &s, const AbstractMetaClass *java_class) {
 
     QSet<QString> values;
 
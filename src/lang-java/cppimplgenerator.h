@@ -45,6 +45,7 @@ enum JNISignatureFormat {
     SlashesAndStuff     //!< Used for looking up functions through jni
 };
 
+QString jni_signature(const AbstractMetaFunction *function, JNISignatureFormat format);
 QString jni_signature(const QString &full_name, JNISignatureFormat format);
 QString jni_signature(const AbstractMetaType *java_type, JNISignatureFormat format = Underscores);
 
@@ -56,76 +57,81 @@ class CppImplGenerator : public CppGenerator {
             JNIExport       = 0x0001,
             ReturnType      = 0x0002,
             ExternC         = 0x0004,
+            Registered      = 0x0008,
 
             StandardJNISignature = JNIExport | ReturnType | ExternC
         };
 
         CppImplGenerator(PriGenerator *pri)
-                : m_native_jump_table(false) {
+                : m_native_jump_table(false),
+                m_class_handle_table(false),
+                m_method_pool(false),
+                m_register_natives(false) {
             priGenerator = pri;
         }
 
         virtual QString fileNameForClass(const AbstractMetaClass *cls) const;
 
-        void write(QTextStream &s, const AbstractMetaClass *java_class);
+        void write(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeSkipped(const AbstractMetaClass *java_class);
 
-        void writeExtraIncludes(QTextStream &s, const AbstractMetaClass *java_class);
+        void writeExtraIncludes(TextBuffer &s, const AbstractMetaClass *java_class);
 
-        void writeAssignment(QTextStream &s, const QString &destName, const QString &srcName,
+        void writeAssignment(TextBuffer &s, const QString &destName, const QString &srcName,
                              const AbstractMetaType *java_type);
-        void writeSignalInitialization(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeCodeInjections(QTextStream &s,
+        void writeSignalInitialization(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeCodeInjections(TextBuffer &s,
                                  const AbstractMetaFunction *java_function,
                                  const AbstractMetaClass *implementor,
                                  CodeSnip::Position position,
                                  TypeSystem::Language language);
-        void writeExtraFunctions(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeToStringFunction(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeCloneFunction(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeShellSignatures(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeShellConstructor(QTextStream &s, const AbstractMetaFunction *java_function, int options = 0);
-        void writeShellDestructor(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeSignalFunction(QTextStream &s, const AbstractMetaFunction *java_function,
+        void writeExtraFunctions(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeToStringFunction(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeCloneFunction(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeShellSignatures(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeShellConstructor(TextBuffer &s, const AbstractMetaFunction *java_function, int options = 0);
+        void writeShellDestructor(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeSignalFunction(TextBuffer &s, const AbstractMetaFunction *java_function,
                                  const AbstractMetaClass *implementor, int pos);
-        void writeShellFunction(QTextStream &s, const AbstractMetaFunction *java_function,
+        void writeShellFunction(TextBuffer &s, const AbstractMetaFunction *java_function,
                                 const AbstractMetaClass *implementor, int pos);
-        void writePublicFunctionOverride(QTextStream &s,
+        void writePublicFunctionOverride(TextBuffer &s,
                                          const AbstractMetaFunction *java_function,
                                          const AbstractMetaClass *java_class);
-        void writeVirtualFunctionOverride(QTextStream &s,
+        void writeVirtualFunctionOverride(TextBuffer &s,
                                           const AbstractMetaFunction *java_function,
                                           const AbstractMetaClass *java_class);
-        bool writeBaseClassFunctionCall(QTextStream &s,
+        bool writeBaseClassFunctionCall(TextBuffer &s,
                                         const AbstractMetaFunction *java_function,
                                         const AbstractMetaClass *java_class,
                                         Option options = NoOption);
-        void writeFinalDestructor(QTextStream &s, const AbstractMetaClass *cls);
-        void writeFinalConstructor(QTextStream &s,
+        void writeFinalDestructor(TextBuffer &s, const AbstractMetaClass *cls);
+        void writeFinalConstructor(TextBuffer &s,
                                    const AbstractMetaFunction *java_function,
                                    const QString &qt_object_name,
                                    const QString &java_object_name);
-        void writeQObjectFunctions(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeFunctionCall(QTextStream &s,
+        void writeQObjectFunctions(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeFunctionCall(TextBuffer &s,
                                const QString &variable_name,
                                const AbstractMetaFunction *java_function,
                                const QString &prefix = QString(),
                                Option option = NoOption,
                                const QStringList &extraParameters = QStringList());
-        void writeFunctionCallArguments(QTextStream &s, const AbstractMetaFunction *java_function,
+        void writeFunctionCallArguments(TextBuffer &s, const AbstractMetaFunction *java_function,
                                         const QString &prefix = QString(), Option option = NoOption);
-        static void writeFunctionName(QTextStream &s,
+        static void writeFunctionName(TextBuffer &s,
                                       const AbstractMetaFunction *java_function,
                                       const AbstractMetaClass *java_class = 0,
                                       uint options = StandardJNISignature);
 
-        void writeJavaToQt(QTextStream &s,
+        void writeJavaToQt(TextBuffer &s,
                            const AbstractMetaClass *java_class,
                            const AbstractMetaType *function_return_type,
                            const QString &qt_name,
                            const QString &java_name,
                            const AbstractMetaFunction *java_function,
                            int argument_index);
-        void writeJavaToQt(QTextStream &s,
+        void writeJavaToQt(TextBuffer &s,
                            const AbstractMetaType *java_type,
                            const QString &qt_name,
                            const QString &java_name,
@@ -133,22 +139,30 @@ class CppImplGenerator : public CppGenerator {
                            int argument_index,
                            Option option = OriginalName);
 
-        void writeFinalFunction(QTextStream &s,
+        void writeFinalFunction(TextBuffer &s,
                                 const AbstractMetaFunction *java_function,
                                 const AbstractMetaClass *java_class);
-        static void writeFinalFunctionArguments(QTextStream &s,
+        static void writeFinalFunctionArguments(TextBuffer &s,
                                                 const AbstractMetaFunction *java_function,
                                                 const QString &java_object_name);
-        void writeFinalFunctionSetup(QTextStream &s,
+        void writeFlattenedValue(TextBuffer &s,
+                                 const AbstractMetaType *java_type,
+                                 const QString &qt_name,
+                                 const QString &java_name);
+        void writeLeafFunctionBody(TextBuffer &s,
+                                   const AbstractMetaFunction *java_function,
+                                   const AbstractMetaClass *cls,
+                                   const QString &qt_object_name);
+        void writeFinalFunctionSetup(TextBuffer &s,
                                      const AbstractMetaFunction *java_function,
                                      const QString &qt_object_name,
                                      const AbstractMetaClass *java_class);
-        void writeOwnership(QTextStream &s,
+        void writeOwnership(TextBuffer &s,
                             const AbstractMetaFunction *java_function,
                             const QString &var_name,
                             int var_index,
                             const AbstractMetaClass *implementor);
-        void writeQtToJava(QTextStream &s,
+        void writeQtToJava(TextBuffer &s,
                            const AbstractMetaType *java_type,
                            const QString &qt_name,
                            const QString &java_name,
@@ -156,39 +170,39 @@ class CppImplGenerator : public CppGenerator {
                            int argument_index,
                            Option option = NoOption);
 
-        bool writeConversionRule(QTextStream &s,
+        bool writeConversionRule(TextBuffer &s,
                                  TypeSystem::Language target_language,
                                  const AbstractMetaFunction *java_function,
                                  int argument_index,
                                  const QString &qt_name,
                                  const QString &java_name);
 
-        void writeFieldAccessors(QTextStream &s, const AbstractMetaField *java_field);
+        void writeFieldAccessors(TextBuffer &s, const AbstractMetaField *java_field);
 
-        void writeOriginalMetaObjectFunction(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeFromNativeFunction(QTextStream &s,
+        void writeOriginalMetaObjectFunction(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeFromNativeFunction(TextBuffer &s,
                                      const AbstractMetaClass *java_class);
-        void writeFromArrayFunction(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeJavaLangObjectOverrideFunctions(QTextStream &s, const AbstractMetaClass *cls);
+        void writeFromArrayFunction(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeJavaLangObjectOverrideFunctions(TextBuffer &s, const AbstractMetaClass *cls);
 
-        void writeInterfaceCastFunction(QTextStream &s,
+        void writeInterfaceCastFunction(TextBuffer &s,
                                         const AbstractMetaClass *java_class,
                                         const AbstractMetaClass *interface);
 
-        void writeQtToJavaContainer(QTextStream &s,
+        void writeQtToJavaContainer(TextBuffer &s,
                                     const AbstractMetaType *java_type,
                                     const QString &qt_name,
                                     const QString &java_name,
                                     const AbstractMetaFunction *java_function,
                                     int argument_index);
-        void writeJavaToQtContainer(QTextStream &s,
+        void writeJavaToQtContainer(TextBuffer &s,
                                     const AbstractMetaType *java_type,
                                     const QString &qt_name,
                                     const QString &java_name,
                                     const AbstractMetaFunction *java_function,
                                     int argument_index);
 
-        void writeDefaultConstructedValues(QTextStream &s, const AbstractMetaClass *java_class);
+        void writeDefaultConstructedValues(TextBuffer &s, const AbstractMetaClass *java_class);
 
         bool hasCustomDestructor(const AbstractMetaClass *java_class) const;
 
@@ -202,13 +216,61 @@ class CppImplGenerator : public CppGenerator {
         bool qtJambiDebugTools() const { return m_qtjambi_debug_tools; }
         void setQtJambiDebugTools(bool bf) { m_qtjambi_debug_tools = bf; }
 
+        bool classHandleTable() const { return m_class_handle_table; }
+        void setClassHandleTable(bool b) { m_class_handle_table = b; }
+
+        static QString classHandleJavaName(const TypeEntry *entry);
+        static QString classHandleName(const TypeEntry *entry);
+
+        bool methodPool() const { return m_method_pool; }
+        void setMethodPool(bool b) { m_method_pool = b; }
+
+        static QString methodPoolName(const QString &package);
+        static QString methodPoolOffsetName(const QString &string);
+
+        bool registerNatives() const { return m_register_natives; }
+        void setRegisterNatives(bool b) { m_register_natives = b; }
+
+        static QString registerNativesFunctionName(const AbstractMetaClass *java_class);
+        static QString registerNativesHelperName(const QString &package);
+
     private:
+        struct NativeMethod {
+            QString java_class;
+            QString name;
+            QString signature;
+            QString function;
+        };
+
+        QString nativeFunction(const AbstractMetaClass *java_class,
+                               const QString &function_name,
+                               const QString &return_type,
+                               const QString &signature,
+                               const QString &mangled_arguments = QString());
+        QString nativeFunction(const AbstractMetaFunction *java_function, const AbstractMetaClass *java_class);
+        void writeRegisterNatives(TextBuffer &s, const AbstractMetaClass *java_class);
+
         void writeDefaultConstructedValues_helper(QSet<QString> &values,
                 const AbstractMetaFunction *function);
         QString fromObject(const TypeEntry *centry, const QString &var_name);
+        void writeMethodString(TextBuffer &s, const AbstractMetaClass *java_class, const QString &string);
+
+        static int localReferenceCount(const AbstractMetaType *java_type,
+                                       const AbstractMetaFunction *java_function,
+                                       int argument_index,
+                                       Option option = NoOption);
+        static int shellFunctionFrameSize(const AbstractMetaFunction *java_function);
+        static int signalFunctionFrameSize(const AbstractMetaFunction *signal, const AbstractMetaClass *cls);
+        void writePushLocalFrame(TextBuffer &s, int size);
+        void writePopLocalFrame(TextBuffer &s, int size);
 
         bool m_native_jump_table;
         bool m_qtjambi_debug_tools;
+        bool m_class_handle_table;
+        bool m_method_pool;
+        bool m_register_natives;
+        QList<NativeMethod> m_native_methods;
+        Indentor INDENT;
 };
 
 #endif // CPPIMPLGENERATOR_H
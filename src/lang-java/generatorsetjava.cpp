@@ -64,6 +64,9 @@ GeneratorSetJava::GeneratorSetJava() :
         docs_enabled(false),
         do_ui_convert(false),
         native_jump_table(false),
+        class_handle_table(false),
+        method_pool(false),
+        register_natives(false),
         doc_dir("../../main/doc/jdoc") {}
 
 QString GeneratorSetJava::usage() {
@@ -73,7 +76,12 @@ QString GeneratorSetJava::usage() {
         "  --no-cpp-h                                \n"
         "  --no-cpp-impl                             \n"
         "  --convert-to-jui=[.ui-file name]          \n"
-        "  --custom-widgets=[file names]             \n";
+        "  --custom-widgets=[file names]             \n"
+        "  --build-threads=[count]                   \n"
+        "  --incremental                             \n"
+        "  --class-handle-table                      \n"
+        "  --method-pool                             \n"
+        "  --register-natives                        \n";
 
     return usage;
 }
@@ -86,6 +94,9 @@ bool GeneratorSetJava::readParameters(const QMap<QString, QString> args) {
     build_class_list = args.contains("build-class-list");
     native_jump_table = args.contains("native-jump-table");
     qtjambi_debug_tools = args.contains("qtjambi-debug-tools");
+    class_handle_table = args.contains("class-handle-table");
+    method_pool = args.contains("method-pool");
+    register_natives = args.contains("register-natives");
 
     if (args.contains("build-qdoc-japi")) {
         no_java = true;
@@ -95,6 +106,40 @@ bool GeneratorSetJava::readParameters(const QMap<QString, QString> args) {
         build_qdoc_japi = true;
     }
 
+    // The glue these options produce includes metainfo.h and relies on
+    // what MetaInfoGenerator writes into it.
+    if (!no_cpp_impl && no_metainfo) {
+        QStringList options;
+        if (class_handle_table)
+            options << "--class-handle-table";
+        if (method_pool)
+            options << "--method-pool";
+        // Static JNI functions are only bound by the registration calls
+        // in the library initializer
+        if (register_natives)
+            options << "--register-natives";
+        if (!options.isEmpty()) {
+            printf("%s cannot be combined with --no-metainfo\n", qPrintable(options.first()));
+            return false;
+        }
+    }
+
+    if (args.contains("build-threads")) {
+        bool ok;
+        int threads = args.value("build-threads").toInt(&ok);
+        if (!ok || threads < 1) {
+            printf("Invalid thread count '%s'\n", qPrintable(args.value("build-threads")));
+            return false;
+        }
+        builder.setThreadCount(threads);
+    }
+
+    if (args.contains("incremental")) {
+        // Outputs generated under different options, or by a different
+        // generator build, are never reused.
+        incremental_key = argumentsKey(args);
+    }
+
     if (args.contains("jdoc-dir")) {
         doc_dir =  args.value("jdoc-dir");
     }
@@ -187,6 +232,9 @@ QString GeneratorSetJava::generate() {
         cpp_impl_generator = new CppImplGenerator(priGenerator);
         cpp_impl_generator->setNativeJumpTable(native_jump_table);
         cpp_impl_generator->setQtJambiDebugTools(qtjambi_debug_tools);
+        cpp_impl_generator->setClassHandleTable(class_handle_table);
+        cpp_impl_generator->setMethodPool(method_pool);
+        cpp_impl_generator->setRegisterNatives(register_natives);
         if (!cppOutDir.isNull())
             cpp_impl_generator->setCppOutputDirectory(cppOutDir);
         generators << cpp_impl_generator;
@@ -202,6 +250,9 @@ QString GeneratorSetJava::generate() {
     if (!no_metainfo) {
         metainfo = new MetaInfoGenerator(priGenerator);
         metainfo->setQtJambiDebugTools(qtjambi_debug_tools);
+        metainfo->setClassHandleTable(class_handle_table);
+        metainfo->setMethodPool(method_pool);
+        metainfo->setRegisterNatives(register_natives);
         if (!cppOutDir.isNull())
             metainfo->setCppOutputDirectory(cppOutDir);
         if (!javaOutDir.isNull())
@@ -229,6 +280,7 @@ QString GeneratorSetJava::generate() {
         if (generator->outputDirectory().isNull())
             generator->setOutputDirectory(outDir);
         generator->setClasses(builder.classes());
+        generator->setIncremental(incremental_key);
         if (printStdout)
             generator->printClasses();
         else
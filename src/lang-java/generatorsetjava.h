@@ -66,10 +66,14 @@ class GeneratorSetJava : public GeneratorSet {
         bool do_ui_convert;
         bool native_jump_table;
         bool qtjambi_debug_tools;
+        bool class_handle_table;
+        bool method_pool;
+        bool register_natives;
 
         QString doc_dir;
         QString ui_file_name;
         QString custom_widgets;
+        QByteArray incremental_key;
 
         MetaJavaBuilder builder;
 
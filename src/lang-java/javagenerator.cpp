@@ -44,12 +44,11 @@
 #include <QtCore/QTextStream>
 #include <QtCore/QVariant>
 #include <QtCore/QRegExp>
+#include <QtCore/QCryptographicHash>
 #include <QDebug>
 #include "typesystem/typedatabase.h"
 #include "wrapper.h"			/* for isTargetPlatformArmCpu */
 
-static Indentor INDENT;
-
 JavaGenerator::JavaGenerator()
         : m_doc_parser(0),
         m_docs_enabled(false),
@@ -60,7 +59,7 @@ QString JavaGenerator::fileNameForClass(const AbstractMetaClass *java_class) con
     return QString("%1.java").arg(java_class->name());
 }
 
-void JavaGenerator::writeFieldAccessors(QTextStream &s, const AbstractMetaField *field) {
+void JavaGenerator::writeFieldAccessors(TextBuffer &s, const AbstractMetaField *field) {
     Q_ASSERT(field->isPublic() || field->isProtected());
 
     const AbstractMetaClass *declaringClass = field->enclosingClass();
@@ -126,6 +125,9 @@ QString JavaGenerator::translateType(const AbstractMetaType *java_type, const Ab
         } else if (java_type->isNativePointer()) {
             s = "com.trolltech.qt.QNativePointer";
 
+        } else if (java_type->isBulkContainer()) {
+            s = translateType(java_type->instantiations().first(), context) + "[]";
+
         } else if (java_type->isContainer()) {
             s = java_type->typeEntry()->qualifiedTargetLangName();
             if ((option & SkipTemplateParameters) == 0) {
@@ -175,7 +177,7 @@ QString JavaGenerator::argumentString(const AbstractMetaFunction *java_function,
     return arg;
 }
 
-void JavaGenerator::writeArgument(QTextStream &s,
+void JavaGenerator::writeArgument(TextBuffer &s,
                                   const AbstractMetaFunction *java_function,
                                   const AbstractMetaArgument *java_argument,
                                   uint options) {
@@ -183,7 +185,7 @@ void JavaGenerator::writeArgument(QTextStream &s,
 }
 
 
-void JavaGenerator::writeIntegerEnum(QTextStream &s, const AbstractMetaEnum *java_enum) {
+void JavaGenerator::writeIntegerEnum(TextBuffer &s, const AbstractMetaEnum *java_enum) {
     const AbstractMetaEnumValueList &values = java_enum->values();
 
     s << "    public static class " << java_enum->name() << "{" << endl;
@@ -204,7 +206,7 @@ void JavaGenerator::writeIntegerEnum(QTextStream &s, const AbstractMetaEnum *jav
     s << "    } // end of enum " << java_enum->name() << endl << endl;
 }
 
-void JavaGenerator::writeEnum(QTextStream &s, const AbstractMetaEnum *java_enum) {
+void JavaGenerator::writeEnum(TextBuffer &s, const AbstractMetaEnum *java_enum) {
     if (m_doc_parser) {
         s << m_doc_parser->documentation(java_enum);
     }
@@ -321,7 +323,7 @@ void JavaGenerator::writeEnum(QTextStream &s, const AbstractMetaEnum *java_enum)
     }
 }
 
-void JavaGenerator::writePrivateNativeFunction(QTextStream &s, const AbstractMetaFunction *java_function) {
+void JavaGenerator::writePrivateNativeFunction(TextBuffer &s, const AbstractMetaFunction *java_function) {
     int exclude_attributes = AbstractMetaAttributes::Public | AbstractMetaAttributes::Protected;
     int include_attributes = 0;
 
@@ -333,14 +335,18 @@ void JavaGenerator::writePrivateNativeFunction(QTextStream &s, const AbstractMet
 //     if (!java_function->isConstructor())
 //         include_attributes |= AbstractMetaAttributes::Static;
 
+    bool flattened = java_function->hasFlattenedReturnType();
     writeFunctionAttributes(s, java_function, include_attributes, exclude_attributes,
                             EnumAsInts
-                            | (java_function->isEmptyFunction()
-                               || java_function->isNormal()
-                               || java_function->isSignal() ? 0 : SkipReturnType));
+                            | (!flattened
+                               && (java_function->isEmptyFunction()
+                                   || java_function->isNormal()
+                                   || java_function->isSignal()) ? 0 : SkipReturnType));
 
     if (java_function->isConstructor())
         s << "void ";
+    else if (flattened)
+        s << "long ";
     s << java_function->marshalledName();
 
     s << "(";
@@ -375,6 +381,29 @@ void JavaGenerator::writePrivateNativeFunction(QTextStream &s, const AbstractMet
     }
 }
 
+/*!
+    Returns the constructor arguments that rebuild a flattened value type
+    from the jlong \a packed that CppImplGenerator::writeFlattenedValue()
+    produced: the first field in the high word, the second in the low word.
+*/
+QString JavaGenerator::flattenedValueArguments(const AbstractMetaType *java_type, const QString &packed) const {
+    const AbstractMetaClass *cls = classes().findClass(java_type->typeEntry()->qualifiedCppName());
+    Q_ASSERT(cls);
+
+    AbstractMetaFunctionList getters = cls->flattenedFieldGetters();
+    QStringList arguments;
+    for (int i = 0; i < getters.size(); ++i) {
+        QString field = i == 0 && getters.size() == 2 ? "(" + packed + " >>> 32)" : packed;
+        QString type = translateType(getters.at(i)->type(), cls);
+        if (type == "boolean")
+            arguments << "((int) " + field + ") != 0";
+        else
+            arguments << "(" + type + ") " + field;
+    }
+
+    return arguments.join(", ");
+}
+
 static QString function_call_for_ownership(TypeSystem::Ownership owner) {
     if (owner == TypeSystem::CppOwnership) {
         return "disableGarbageCollection()";
@@ -389,7 +418,7 @@ static QString function_call_for_ownership(TypeSystem::Ownership owner) {
     }
 }
 
-void JavaGenerator::writeOwnershipForContainer(QTextStream &s, TypeSystem::Ownership owner,
+void JavaGenerator::writeOwnershipForContainer(TextBuffer &s, TypeSystem::Ownership owner,
         AbstractMetaType *type, const QString &arg_name) {
     Q_ASSERT(type->isContainer());
 
@@ -399,7 +428,7 @@ void JavaGenerator::writeOwnershipForContainer(QTextStream &s, TypeSystem::Owner
 
 }
 
-void JavaGenerator::writeOwnershipForContainer(QTextStream &s, TypeSystem::Ownership owner,
+void JavaGenerator::writeOwnershipForContainer(TextBuffer &s, TypeSystem::Ownership owner,
         AbstractMetaArgument *arg) {
     writeOwnershipForContainer(s, owner, arg->type(), arg->argumentName());
 }
@@ -417,7 +446,7 @@ static FunctionModificationList get_function_modifications_for_class_hierarchy(c
     return mods;
 }
 
-void JavaGenerator::writeInjectedCode(QTextStream &s, const AbstractMetaFunction *java_function,
+void JavaGenerator::writeInjectedCode(TextBuffer &s, const AbstractMetaFunction *java_function,
                                       CodeSnip::Position position) {
     FunctionModificationList mods = get_function_modifications_for_class_hierarchy(java_function);
     foreach(FunctionModification mod, mods) {
@@ -432,7 +461,7 @@ void JavaGenerator::writeInjectedCode(QTextStream &s, const AbstractMetaFunction
                 continue ;
 
             QString code;
-            QTextStream tmpStream(&code);
+            TextBuffer tmpStream(&code);
             snip.formattedCode(tmpStream, INDENT);
             ArgumentMap map = snip.argumentMap;
             ArgumentMap::iterator it = map.begin();
@@ -456,7 +485,7 @@ void JavaGenerator::writeInjectedCode(QTextStream &s, const AbstractMetaFunction
 }
 
 
-void JavaGenerator::writeJavaCallThroughContents(QTextStream &s, const AbstractMetaFunction *meta_function, uint attributes) {
+void JavaGenerator::writeJavaCallThroughContents(TextBuffer &s, const AbstractMetaFunction *meta_function, uint attributes) {
     const MetaJavaFunction * java_function = (const MetaJavaFunction *)meta_function;
     writeInjectedCode(s, java_function, CodeSnip::Beginning);
 
@@ -578,7 +607,9 @@ void JavaGenerator::writeJavaCallThroughContents(QTextStream &s, const AbstractM
                                  && (owner != TypeSystem::InvalidOwnership || has_argument_referenceCounts || returnReferenceCounts.size() > 0 || has_code_injections_at_the_end);
 
     s << INDENT;
-    if (has_return_type && java_function->argumentReplaced(0).isEmpty()) {
+    if (java_function->hasFlattenedReturnType()) {
+        s << "long __qt_packed_return_value = ";
+    } else if (has_return_type && java_function->argumentReplaced(0).isEmpty()) {
         if (needs_return_variable) {
             if (new_return_type.isEmpty())
                 s << translateType(return_type, java_function->implementingClass());
@@ -682,6 +713,13 @@ void JavaGenerator::writeJavaCallThroughContents(QTextStream &s, const AbstractM
 
     s << ";" << endl;
 
+    if (java_function->hasFlattenedReturnType()) {
+        QString value_type = translateType(return_type, java_function->implementingClass());
+        s << INDENT << (needs_return_variable ? value_type + " __qt_return_value = " : QString("return "))
+        << "new " << value_type << "("
+        << flattenedValueArguments(return_type, "__qt_packed_return_value") << ");" << endl;
+    }
+
     // We must ensure we retain a Java hard-reference over the native method call
     // so that the GC will not destroy the C++ object too early.  At this point we
     // have called the native method call so can manage referenceCount issues.
@@ -725,7 +763,7 @@ void JavaGenerator::writeJavaCallThroughContents(QTextStream &s, const AbstractM
     }
 }
 
-void JavaGenerator::writeSignal(QTextStream &s, const AbstractMetaFunction *java_function) {
+void JavaGenerator::writeSignal(TextBuffer &s, const AbstractMetaFunction *java_function) {
     Q_ASSERT(java_function->isSignal());
 
     if (java_function->isModifiedRemoved(TypeSystem::TargetLangCode))
@@ -852,7 +890,7 @@ QString JavaGenerator::functionSignature(const AbstractMetaFunction *java_functi
     int argument_count = arg_count < 0 ? arguments.size() : arg_count;
 
     QString result;
-    QTextStream s(&result);
+    TextBuffer s(&result);
     QString functionName = java_function->name();
     // The actual function
     if (!(java_function->isEmptyFunction() || java_function->isNormal() || java_function->isSignal()))
@@ -881,7 +919,7 @@ void JavaGenerator::setupForFunction(const AbstractMetaFunction *java_function,
     retrieveModifications(java_function, java_class, excluded_attributes, included_attributes);
 }
 
-void JavaGenerator::writeReferenceCount(QTextStream &s, const ReferenceCount &refCount,
+void JavaGenerator::writeReferenceCount(TextBuffer &s, const ReferenceCount &refCount,
                                         const QString &argumentName) {
     if (refCount.action == ReferenceCount::Ignore)
         return;
@@ -932,7 +970,7 @@ void JavaGenerator::writeReferenceCount(QTextStream &s, const ReferenceCount &re
     s << INDENT << "}" << endl;
 }
 
-void JavaGenerator::writeFunction(QTextStream &s, const AbstractMetaFunction *meta_function,
+void JavaGenerator::writeFunction(TextBuffer &s, const AbstractMetaFunction *meta_function,
                                   uint included_attributes, uint excluded_attributes) {
     const MetaJavaFunction * java_function = (const MetaJavaFunction *)meta_function;
     s << endl;
@@ -1047,7 +1085,7 @@ void JavaGenerator::writeFunction(QTextStream &s, const AbstractMetaFunction *me
     }
 }
 
-static void write_equals_parts(QTextStream &s, const AbstractMetaFunctionList &lst, char prefix, bool *first) {
+static void write_equals_parts(TextBuffer &s, Indentor &INDENT, const AbstractMetaFunctionList &lst, char prefix, bool *first) {
     foreach(AbstractMetaFunction *f, lst) {
         AbstractMetaArgument *arg = f->arguments().at(0);
         QString type = f->typeReplaced(1);
@@ -1061,7 +1099,7 @@ static void write_equals_parts(QTextStream &s, const AbstractMetaFunctionList &l
     }
 }
 
-static void write_compareto_parts(QTextStream &s, const AbstractMetaFunctionList &lst, int value, bool *first) {
+static void write_compareto_parts(TextBuffer &s, Indentor &INDENT, const AbstractMetaFunctionList &lst, int value, bool *first) {
     foreach(AbstractMetaFunction *f, lst) {
         AbstractMetaArgument *arg = f->arguments().at(0);
         QString type = f->typeReplaced(1);
@@ -1095,7 +1133,7 @@ bool JavaGenerator::isComparable(const AbstractMetaClass *cls) const {
 }
 
 
-void JavaGenerator::writeJavaLangObjectOverrideFunctions(QTextStream &s,
+void JavaGenerator::writeJavaLangObjectOverrideFunctions(TextBuffer &s,
         const AbstractMetaClass *cls) {
     AbstractMetaFunctionList eq_functions = cls->equalsFunctions();
     AbstractMetaFunctionList neq_functions = cls->notEqualsFunctions();
@@ -1106,8 +1144,8 @@ void JavaGenerator::writeJavaLangObjectOverrideFunctions(QTextStream &s,
         << INDENT << "@Override" << endl
         << INDENT << "public boolean equals(Object other) {" << endl;
         bool first = true;
-        write_equals_parts(s, eq_functions, (char) 0, &first);
-        write_equals_parts(s, neq_functions, '!', &first);
+        write_equals_parts(s, INDENT, eq_functions, (char) 0, &first);
+        write_equals_parts(s, INDENT, neq_functions, '!', &first);
         s << INDENT << "    return false;" << endl
         << INDENT << "}" << endl << endl;
     }
@@ -1128,13 +1166,13 @@ void JavaGenerator::writeJavaLangObjectOverrideFunctions(QTextStream &s,
                 s << INDENT << "if (equals(other)) return 0;" << endl;
                 bool first = false;
                 if (le_functions.size()) {
-                    write_compareto_parts(s, le_functions, -1, &first);
+                    write_compareto_parts(s, INDENT, le_functions, -1, &first);
                 } else if (ge_functions.size()) {
-                    write_compareto_parts(s, ge_functions, 1, &first);
+                    write_compareto_parts(s, INDENT, ge_functions, 1, &first);
                 } else if (leq_functions.size()) {
-                    write_compareto_parts(s, leq_functions, -1, &first);
+                    write_compareto_parts(s, INDENT, leq_functions, -1, &first);
                 } else if (geq_functions.size()) {
-                    write_compareto_parts(s, geq_functions, 1, &first);
+                    write_compareto_parts(s, INDENT, geq_functions, 1, &first);
                 }
 
             } else if (le_functions.size() == 1) {
@@ -1211,7 +1249,7 @@ void JavaGenerator::writeJavaLangObjectOverrideFunctions(QTextStream &s,
     }
 }
 
-void JavaGenerator::writeEnumOverload(QTextStream &s, const AbstractMetaFunction *java_function,
+void JavaGenerator::writeEnumOverload(TextBuffer &s, const AbstractMetaFunction *java_function,
                                       uint include_attributes, uint exclude_attributes) {
     AbstractMetaArgumentList arguments = java_function->arguments();
 
@@ -1280,7 +1318,7 @@ void JavaGenerator::writeEnumOverload(QTextStream &s, const AbstractMetaFunction
     }
 }
 
-void JavaGenerator::writeInstantiatedType(QTextStream &s, const AbstractMetaType *abstractMetaType) const {
+void JavaGenerator::writeInstantiatedType(TextBuffer &s, const AbstractMetaType *abstractMetaType) const {
     Q_ASSERT(abstractMetaType != 0);
 
     const TypeEntry *type = abstractMetaType->typeEntry();
@@ -1343,7 +1381,7 @@ abort:
     return QString(tmpString);
 }
 
-void JavaGenerator::writeFunctionOverloads(QTextStream &s, const AbstractMetaFunction *java_function,
+void JavaGenerator::writeFunctionOverloads(TextBuffer &s, const AbstractMetaFunction *java_function,
         uint include_attributes, uint exclude_attributes) {
     AbstractMetaArgumentList arguments = java_function->arguments();
     int argument_count = arguments.size();
@@ -1469,7 +1507,24 @@ void JavaGenerator::writeFunctionOverloads(QTextStream &s, const AbstractMetaFun
     }
 }
 
-void JavaGenerator::write(QTextStream &s, const AbstractMetaClass *java_class) {
+/*!
+    The documentation read from the .jdoc file of \a cls ends up in the
+    output, so it is part of the fingerprint when documentation is enabled.
+*/
+QByteArray JavaGenerator::outputFingerprint(const AbstractMetaClass *cls) const {
+    QByteArray fingerprint = classFingerprint(cls);
+    if (!m_docs_enabled)
+        return fingerprint;
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(fingerprint);
+    QFile file(m_doc_directory + "/" + cls->name().toLower() + ".jdoc");
+    if (file.open(QIODevice::ReadOnly))
+        hash.addData(file.readAll());
+    return hash.result();
+}
+
+void JavaGenerator::write(TextBuffer &s, const AbstractMetaClass *java_class) {
     ReportHandler::debugSparse("Generating class: " + java_class->fullName());
 
     bool fakeClass = java_class->attributes() & AbstractMetaAttributes::Fake;
@@ -1964,7 +2019,7 @@ void JavaGenerator::generate() {
     }
 }
 
-void JavaGenerator::writeFunctionAttributes(QTextStream &s, const AbstractMetaFunction *java_function,
+void JavaGenerator::writeFunctionAttributes(TextBuffer &s, const AbstractMetaFunction *java_function,
         uint included_attributes, uint excluded_attributes,
         uint options) {
     uint attr = (java_function->attributes() & (~excluded_attributes)) | included_attributes;
@@ -2098,7 +2153,7 @@ void JavaGenerator::writeFunctionAttributes(QTextStream &s, const AbstractMetaFu
     }
 }
 
-void JavaGenerator::writeConstructorContents(QTextStream &s, const AbstractMetaFunction *meta_function) {
+void JavaGenerator::writeConstructorContents(TextBuffer &s, const AbstractMetaFunction *meta_function) {
     // Write constructor
     const MetaJavaFunction * java_function = (const MetaJavaFunction *)meta_function;
     s << "{" << endl;
@@ -2131,7 +2186,7 @@ void JavaGenerator::writeConstructorContents(QTextStream &s, const AbstractMetaF
         writePrivateNativeFunction(s, java_function);
 }
 
-void JavaGenerator::writeFunctionArguments(QTextStream &s, const AbstractMetaFunction *java_function,
+void JavaGenerator::writeFunctionArguments(TextBuffer &s, const AbstractMetaFunction *java_function,
         int argument_count, uint options) {
     AbstractMetaArgumentList arguments = java_function->arguments();
 
@@ -2148,7 +2203,7 @@ void JavaGenerator::writeFunctionArguments(QTextStream &s, const AbstractMetaFun
 }
 
 
-void JavaGenerator::writeExtraFunctions(QTextStream &s, const AbstractMetaClass *java_class) {
+void JavaGenerator::writeExtraFunctions(TextBuffer &s, const AbstractMetaClass *java_class) {
     const ComplexTypeEntry *class_type = java_class->typeEntry();
     Q_ASSERT(class_type);
 
@@ -2163,7 +2218,7 @@ void JavaGenerator::writeExtraFunctions(QTextStream &s, const AbstractMetaClass
 }
 
 
-void JavaGenerator::writeToStringFunction(QTextStream &s, const AbstractMetaClass *java_class) {
+void JavaGenerator::writeToStringFunction(TextBuffer &s, const AbstractMetaClass *java_class) {
     bool generate = java_class->hasToStringCapability() && !java_class->hasDefaultToStringFunction();
     bool core = java_class->package() == QLatin1String("com.trolltech.qt.core");
     bool qevent = false;
@@ -2198,7 +2253,7 @@ void JavaGenerator::writeToStringFunction(QTextStream &s, const AbstractMetaClas
     }
 }
 
-void JavaGenerator::writeCloneFunction(QTextStream &s, const AbstractMetaClass *java_class) {
+void JavaGenerator::writeCloneFunction(TextBuffer &s, const AbstractMetaClass *java_class) {
     s << endl
     << "    @Override" << endl
     << "    public " << java_class->name() << " clone() {" << endl
@@ -52,46 +52,47 @@ class JavaGenerator : public Generator {
 
         static QString translateType(const AbstractMetaType *java_type, const AbstractMetaClass *context, Option option = NoOption);
 
-        void writeInjectedCode(QTextStream &s,
+        void writeInjectedCode(TextBuffer &s,
                                const AbstractMetaFunction *java_function,
                                CodeSnip::Position position);
-        static void writeArgument(QTextStream &s,
+        static void writeArgument(TextBuffer &s,
                                   const AbstractMetaFunction *java_function,
                                   const AbstractMetaArgument *java_argument,
                                   uint options = 0);
         static QString argumentString(const AbstractMetaFunction *java_function,
                                       const AbstractMetaArgument *java_argument,
                                       uint options = 0);
-        void writeEnum(QTextStream &s, const AbstractMetaEnum *java_enum);
-        void writeIntegerEnum(QTextStream &s, const AbstractMetaEnum *java_enum);
-        void writeSignal(QTextStream &s, const AbstractMetaFunction *java_function);
-        void writeFunction(QTextStream &s, const AbstractMetaFunction *java_function,
+        void writeEnum(TextBuffer &s, const AbstractMetaEnum *java_enum);
+        void writeIntegerEnum(TextBuffer &s, const AbstractMetaEnum *java_enum);
+        void writeSignal(TextBuffer &s, const AbstractMetaFunction *java_function);
+        void writeFunction(TextBuffer &s, const AbstractMetaFunction *java_function,
                            uint included_attributes = 0, uint excluded_attributes = 0);
-        void writeFieldAccessors(QTextStream &s, const AbstractMetaField *field);
-        void write(QTextStream &s, const AbstractMetaClass *java_class);
+        void writeFieldAccessors(TextBuffer &s, const AbstractMetaField *field);
+        void write(TextBuffer &s, const AbstractMetaClass *java_class);
 
         QString arm_platform_kludge_defaultValue(const QString &defaultExpr) const;
 
-        void writeFunctionOverloads(QTextStream &s, const AbstractMetaFunction *java_function,
+        void writeFunctionOverloads(TextBuffer &s, const AbstractMetaFunction *java_function,
                                     uint included_attributes, uint excluded_attributes);
-        void writeEnumOverload(QTextStream &s, const AbstractMetaFunction *java_function,
+        void writeEnumOverload(TextBuffer &s, const AbstractMetaFunction *java_function,
                                uint include_attributes, uint exclude_attributes);
-        void writeExtraFunctions(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeToStringFunction(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeCloneFunction(QTextStream &s, const AbstractMetaClass *java_class);
-        void writeFunctionAttributes(QTextStream &s, const AbstractMetaFunction *java_function,
+        void writeExtraFunctions(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeToStringFunction(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeCloneFunction(TextBuffer &s, const AbstractMetaClass *java_class);
+        void writeFunctionAttributes(TextBuffer &s, const AbstractMetaFunction *java_function,
                                      uint included_attributes = 0, uint excluded_attributes = 0,
                                      uint options = 0);
-        void writeConstructorContents(QTextStream &s, const AbstractMetaFunction *java_function);
-        void writeFunctionArguments(QTextStream &s, const AbstractMetaFunction *java_function,
+        void writeConstructorContents(TextBuffer &s, const AbstractMetaFunction *java_function);
+        void writeFunctionArguments(TextBuffer &s, const AbstractMetaFunction *java_function,
                                     int count = -1, uint options = 0);
-        void writeJavaCallThroughContents(QTextStream &s, const AbstractMetaFunction *java_function, uint attributes = 0);
-        void writeOwnershipForContainer(QTextStream &s, TypeSystem::Ownership ownership, AbstractMetaArgument *arg);
-        void writeOwnershipForContainer(QTextStream &s, TypeSystem::Ownership ownership, AbstractMetaType *type,
+        void writeJavaCallThroughContents(TextBuffer &s, const AbstractMetaFunction *java_function, uint attributes = 0);
+        void writeOwnershipForContainer(TextBuffer &s, TypeSystem::Ownership ownership, AbstractMetaArgument *arg);
+        void writeOwnershipForContainer(TextBuffer &s, TypeSystem::Ownership ownership, AbstractMetaType *type,
                                         const QString &arg_name);
-        void writePrivateNativeFunction(QTextStream &s, const AbstractMetaFunction *java_function);
-        void writeJavaLangObjectOverrideFunctions(QTextStream &s, const AbstractMetaClass *cls);
-        void writeReferenceCount(QTextStream &s, const ReferenceCount &refCount, const QString &argumentName);
+        void writePrivateNativeFunction(TextBuffer &s, const AbstractMetaFunction *java_function);
+        QString flattenedValueArguments(const AbstractMetaType *java_type, const QString &packed) const;
+        void writeJavaLangObjectOverrideFunctions(TextBuffer &s, const AbstractMetaClass *cls);
+        void writeReferenceCount(TextBuffer &s, const ReferenceCount &refCount, const QString &argumentName);
         void retrieveModifications(const AbstractMetaFunction *f, const AbstractMetaClass *java_class,
                                    uint *exclude_attributes, uint *include_attributes) const;
         QString functionSignature(const AbstractMetaFunction *java_function,
@@ -110,7 +111,7 @@ class JavaGenerator : public Generator {
         bool isComparable(const AbstractMetaClass *cls) const;
 
 #if 0
-        void write1_dot_5_enum(QTextStream &s, const AbstractMetaEnum *java_enum);
+        void write1_dot_5_enum(TextBuffer &s, const AbstractMetaEnum *java_enum);
 #endif
 
         bool shouldGenerate(const AbstractMetaClass *java_class) const {
@@ -146,9 +147,11 @@ class JavaGenerator : public Generator {
 
     private:
         QString subDirectoryForPackage(const QString &package) const { return QString(package).replace(".", "/"); }
-        void writeInstantiatedType(QTextStream &s, const AbstractMetaType *abstractMetaType) const;
+        void writeInstantiatedType(TextBuffer &s, const AbstractMetaType *abstractMetaType) const;
 
     protected:
+        QByteArray outputFingerprint(const AbstractMetaClass *cls) const;
+
         QString m_package_name;
         QString m_doc_directory;
         QString m_java_out_dir;
@@ -159,6 +162,7 @@ class JavaGenerator : public Generator {
         QList<const AbstractMetaFunction *> m_nativepointer_functions;
         QList<const AbstractMetaFunction *> m_resettable_object_functions;
         QList<const AbstractMetaFunction *> m_reference_count_candidate_functions;
+        Indentor INDENT;
 };
 
 #endif // JAVAGENERATOR_H
@@ -245,7 +245,7 @@ void JumpTableGenerator::generateJavaTable(const QString &packageName,
 
     FileOut file(tableFile);
 
-    QTextStream &s = file.stream;
+    TextBuffer &s = file.stream;
 
     s << "package " << packageName << ";" << endl << endl;
     s << "class JTbl {" << endl;
@@ -282,7 +282,7 @@ void JumpTableGenerator::generateNativeTable(const QString &packageName,
 
     printf("Generating jump table (.cpp): %s\n", qPrintable(tableFile));
 
-    QTextStream &s = file.stream;
+    TextBuffer &s = file.stream;
 
     s << "#include <qtjambi/qtjambi_global.h>" << endl;
 
@@ -290,31 +290,35 @@ void JumpTableGenerator::generateNativeTable(const QString &packageName,
         QString signature = sit.key();
 
         QString ret = expandNameJNI(signature.at(0));
+        QString tableName = "JTbl_" + signature;
 
-        s << endl << endl
-        << "extern \"C\" Q_DECL_EXPORT " << ret << " JNICALL QTJAMBI_FUNCTION_PREFIX(Java_"
-        << QString(packageName).replace("_", "_1").replace(".", "_") << "_JTbl_" << signature << ")" << endl
-        << "(JNIEnv *e, jclass, jint id, jlong nid";
+        AbstractMetaFunctionList functions = sit.value();
+        bool hasReturn = signature.at(0) != 'V';
 
+        QString arguments;
+        QString parameters;
         for (int i = 1; i < signature.size(); ++i) {
-            s << ", " << expandNameJNI(signature.at(i)) << " a" << i;
+            arguments += QString(", a%1").arg(i);
+            parameters += QString(", %1 a%2").arg(expandNameJNI(signature.at(i))).arg(i);
         }
 
-        s << ", jobject __this)" << endl
-        << "{" << endl
-        << "Q_UNUSED(__this);" << endl
-        << "Q_UNUSED(nid);" << endl
-        << "switch (id) { " << endl;
-
-        AbstractMetaFunctionList functions = sit.value();
-        bool hasReturn = signature.at(0) != 'V';
+        // All functions of one shape are reached through the same pointer
+        // type, so each gets a small trampoline that forwards to the real
+        // implementation with its own argument list.
+        s << endl << endl
+        << "typedef " << ret << " (*" << tableName << "_Function)(JNIEnv *e, jobject __this, jlong nid"
+        << parameters << ");" << endl;
 
         foreach(AbstractMetaFunction *mf, functions) {
             const MetaJavaFunction * f = (const MetaJavaFunction *)mf;
             const AbstractMetaClass *cls = f->ownerClass();
             s << endl
             << "// " << cls->name() << "::" << f->signature() << ", declaring=" << f->declaringClass()->name() << ", implementing=" << f->implementingClass()->name() << endl
-            << "case " << f->jumpTableId() << ":" << endl
+            << "static " << ret << " " << tableName << "_" << f->jumpTableId()
+            << "(JNIEnv *e, jobject __this, jlong nid" << parameters << ")" << endl
+            << "{" << endl
+            << "Q_UNUSED(__this);" << endl
+            << "Q_UNUSED(nid);" << endl
             << "extern ";
             CppImplGenerator::writeFunctionName(s, f, cls, CppImplGenerator::ReturnType);
             s << endl;
@@ -335,20 +339,33 @@ void JumpTableGenerator::generateNativeTable(const QString &packageName,
             else
                 s << ", __this, nid";
 
-            for (int i = 1; i < signature.size(); ++i) {
-                s << ", a" << i;
-            }
+            s << arguments << ");" << endl;
 
-            s << ");" << endl
-            << "break;" << endl;
-        }
+            if (hasReturn && f->isConstructor())
+                s << "return 0;" << endl;
 
-        s << "} // switch..." << endl;
+            s << "}" << endl;
+        }
 
-        if (hasReturn)
-            s << "return 0;" << endl;
+        // Jump table ids are handed out from 1 in the order the functions
+        // were added to the signature list.
+        s << endl
+        << "static const " << tableName << "_Function " << tableName << "_table[] = {" << endl;
+        for (int i = 0; i < functions.size(); ++i) {
+            Q_ASSERT(((const MetaJavaFunction *) functions.at(i))->jumpTableId() == i + 1);
+            s << "    " << tableName << "_" << (i + 1) << (i + 1 < functions.size() ? "," : "") << endl;
+        }
+        s << "};" << endl;
 
-        s << "} // " << signature << endl;
+        s << endl
+        << "extern \"C\" Q_DECL_EXPORT " << ret << " JNICALL QTJAMBI_FUNCTION_PREFIX(Java_"
+        << QString(packageName).replace("_", "_1").replace(".", "_") << "_JTbl_" << signature << ")" << endl
+        << "(JNIEnv *e, jclass, jint id, jlong nid" << parameters << ", jobject __this)" << endl
+        << "{" << endl
+        << "if (id < 1 || id > " << functions.size() << ")" << endl
+        << "    return" << (hasReturn ? " 0" : "") << ";" << endl
+        << (hasReturn ? "return " : "") << tableName << "_table[id - 1](e, __this, nid" << arguments << ");" << endl
+        << "} // " << signature << endl;
     }
 }
 
@@ -40,12 +40,18 @@
 #include "fileout.h"
 
 #include <QDir>
+#include <QFileInfo>
 #include <QMetaType>
+#include <QCryptographicHash>
 #include "typesystem/typedatabase.h"
 
 MetaInfoGenerator::MetaInfoGenerator(PriGenerator *pri):
         JavaGenerator(),
-        priGenerator(pri)
+        priGenerator(pri),
+        m_qtjambi_debug_tools(false),
+        m_class_handle_table(false),
+        m_method_pool(false),
+        m_register_natives(false)
 
 {
     setFilenameStub("metainfo");
@@ -69,9 +75,85 @@ QString MetaInfoGenerator::subDirectoryForClass(const AbstractMetaClass *cls, Ou
 
 void MetaInfoGenerator::generate() {
     buildSkipList();
-    writeCppFile();
-    writeHeaderFile();
+
+    // The meta info files of a package are written from the whole model,
+    // so in incremental mode they are rewritten together or not at all.
+    QByteArray fingerprint;
+    AbstractMetaClassList packageClasses = metaInfoPackageClasses();
+    bool upToDate = isIncremental();
+    if (isIncremental()) {
+        loadFingerprints();
+        fingerprint = metaInfoFingerprint();
+        foreach(const AbstractMetaClass *cls, packageClasses) {
+            QString dir = cppOutputDirectory() + "/" + subDirectoryForClass(cls, CppDirectory) + "/";
+            upToDate = upToDate && isUpToDate(dir + cppFilename(), fingerprint)
+                       && isUpToDate(dir + headerFilename(), fingerprint);
+        }
+    }
+
+    if (upToDate) {
+        foreach(const AbstractMetaClass *cls, packageClasses) {
+            QString pro_file_name = cls->package().replace(".", "_") + "/" + cls->package().replace(".", "_") + ".pri";
+            priGenerator->addSource(pro_file_name, cppFilename());
+            priGenerator->addHeader(pro_file_name, headerFilename());
+
+            QString dir = cppOutputDirectory() + "/" + subDirectoryForClass(cls, CppDirectory) + "/";
+            FileOut::outputFiles << QFileInfo(dir + cppFilename()).absoluteFilePath()
+                                 << QFileInfo(dir + headerFilename()).absoluteFilePath();
+            m_num_generated += 2;
+        }
+    } else {
+        writeCppFile();
+        writeHeaderFile();
+    }
+
+    if (isIncremental()) {
+        foreach(const AbstractMetaClass *cls, packageClasses) {
+            QString dir = cppOutputDirectory() + "/" + subDirectoryForClass(cls, CppDirectory) + "/";
+            recordOutput(dir + cppFilename(), fingerprint);
+            recordOutput(dir + headerFilename(), fingerprint);
+        }
+    }
+
     writeLibraryInitializers();
+
+    m_num_generated_written -= FileOut::waitForWrites();
+
+    if (isIncremental())
+        saveFingerprints();
+}
+
+/**
+ * Returns the first class of each package that gets meta info files.
+ */
+AbstractMetaClassList MetaInfoGenerator::metaInfoPackageClasses() const {
+    AbstractMetaClassList packageClasses;
+    QSet<QString> packages;
+    foreach(AbstractMetaClass *cls, classes()) {
+        if (generated(cls) && !packages.contains(cls->package())) {
+            packages.insert(cls->package());
+            packageClasses << cls;
+        }
+    }
+    return packageClasses;
+}
+
+/**
+ * Fingerprint of everything the meta info files are written from: every
+ * class in the model plus the typesystem files, which also declare the
+ * primitive types registered in each package.
+ */
+QByteArray MetaInfoGenerator::metaInfoFingerprint() const {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    foreach(const AbstractMetaClass *cls, classes())
+        hash.addData(classFingerprint(cls));
+
+    foreach(const QString &input, TypeDatabase::instance()->inputFiles()) {
+        QFile file(input);
+        if (file.open(QIODevice::ReadOnly))
+            hash.addData(file.readAll());
+    }
+    return hash.result();
 }
 
 bool MetaInfoGenerator::shouldGenerate(const TypeEntry *entry) const {
@@ -87,7 +169,7 @@ QString MetaInfoGenerator::fileNameForClass(const AbstractMetaClass *) const {
     return filenameStub() + ".cpp";
 }
 
-void MetaInfoGenerator::write(QTextStream &, const AbstractMetaClass *) {
+void MetaInfoGenerator::write(TextBuffer &, const AbstractMetaClass *) {
     // not used
 }
 
@@ -103,7 +185,7 @@ bool MetaInfoGenerator::generatedJavaClasses(const QString &package) const {
     return (m_skip_list.value(package, 0x0) & GeneratedJavaClasses);
 }
 
-static void metainfo_write_name_list(QTextStream &s, const char *var_name, const QList<QString> &strs,
+static void metainfo_write_name_list(TextBuffer &s, const char *var_name, const QList<QString> &strs,
                                      int offset, int skip) {
     s << "static const char *" << var_name << "[] = {" << endl;
     for (int i = offset; i < strs.size(); i += skip) {
@@ -115,7 +197,7 @@ static void metainfo_write_name_list(QTextStream &s, const char *var_name, const
     s << "};" << endl << endl;
 }
 
-void MetaInfoGenerator::writeEnums(QTextStream &s, const QString &package) {
+void MetaInfoGenerator::writeEnums(TextBuffer &s, const QString &package) {
     TypeEntryHash entries = TypeDatabase::instance()->allEntries();
     TypeEntryHash::iterator it;
 
@@ -151,7 +233,7 @@ void MetaInfoGenerator::writeEnums(QTextStream &s, const QString &package) {
     }
 }
 
-void MetaInfoGenerator::writeSignalsAndSlots(QTextStream &s, const QString &package) {
+void MetaInfoGenerator::writeSignalsAndSlots(TextBuffer &s, const QString &package) {
     AbstractMetaClassList classes = this->classes();
 
     QList<QString> strs;
@@ -175,7 +257,7 @@ void MetaInfoGenerator::writeSignalsAndSlots(QTextStream &s, const QString &pack
                         QString qtName;
                         {
 
-                            QTextStream qtNameStream(&qtName);
+                            TextBuffer qtNameStream(&qtName);
                             CppGenerator::writeFunctionSignature(qtNameStream, f, 0, QString(),
                                                                  Option(option | OriginalName | NormalizeAndFixTypeSignature | OriginalTypeDescription),
                                                                  QString(), QStringList(), arguments.size() - i);
@@ -224,7 +306,7 @@ void MetaInfoGenerator::writeSignalsAndSlots(QTextStream &s, const QString &pack
     }
 }
 
-void MetaInfoGenerator::writeRegisterSignalsAndSlots(QTextStream &s) {
+void MetaInfoGenerator::writeRegisterSignalsAndSlots(TextBuffer &s) {
     s << "    for (int i=0;i<sns_count; ++i) {" << endl
     << "        registerQtToJava(qtNames[i], javaFunctionNames[i]);" << endl
     << "        if (getQtName(javaObjectNames[i]).length() < QByteArray(qtNames[i]).size())" << endl
@@ -233,7 +315,7 @@ void MetaInfoGenerator::writeRegisterSignalsAndSlots(QTextStream &s) {
     << "    }" << endl;
 }
 
-void MetaInfoGenerator::writeRegisterEnums(QTextStream &s) {
+void MetaInfoGenerator::writeRegisterEnums(TextBuffer &s) {
     s << "    for (int i=0;i<enum_count; ++i) {" << endl
     << "        registerQtToJava(enumCppNames[i], enumJavaNames[i]);" << endl
     << "        registerJavaToQt(enumJavaNames[i], enumCppNames[i]);" << endl
@@ -257,64 +339,335 @@ void MetaInfoGenerator::buildSkipList() {
     }
 }
 
-QStringList MetaInfoGenerator::writePolymorphicHandler(QTextStream &s, const QString &package,
+/**
+ * Tries to turn the polymorphic ids of \a subclasses into the cases of one
+ * switch. This works when every id is a comparison of the same
+ * discriminator with enum values, "%1->type() == QEvent::Timer", possibly
+ * several joined by ||. The values are resolved through the model so that
+ * two spellings of one value end up in the same case, and the first class
+ * to claim a value keeps it, as it would in a chain of ifs. Values the
+ * builder had to guess make the whole handler fall back to the ifs. The
+ * case labels are stored in \a labels, keyed by value.
+ */
+bool MetaInfoGenerator::polymorphicIdSwitch(const AbstractMetaClassList &subclasses, QString *discriminator,
+        QMap<int, QPair<QString, const AbstractMetaClass *> > *labels) const {
+    static QRegExp enum_value("[A-Za-z_][A-Za-z0-9_]*(::[A-Za-z_][A-Za-z0-9_]*)+");
+
+    AbstractMetaClassList classList = classes();
+    discriminator->clear();
+    labels->clear();
+
+    foreach(const AbstractMetaClass *clazz, subclasses) {
+        QString expression = clazz->typeEntry()->polymorphicIdValue();
+        if (expression.contains("&&"))
+            return false;
+
+        foreach(QString term, expression.split("||")) {
+            int pos = term.indexOf("==");
+            if (pos < 0 || term.indexOf("==", pos + 2) >= 0)
+                return false;
+
+            QString lhs = term.left(pos).trimmed();
+            QString rhs = term.mid(pos + 2).trimmed();
+            if (!enum_value.exactMatch(rhs))
+                return false;
+            if (discriminator->isEmpty())
+                *discriminator = lhs;
+            else if (*discriminator != lhs)
+                return false;
+
+            int scope = rhs.lastIndexOf("::");
+            AbstractMetaClass *owner = classList.findClass(rhs.left(scope));
+            AbstractMetaEnumValue *value = owner != 0 ? owner->findEnumValue(rhs.mid(scope + 2), 0) : 0;
+            if (value == 0 || !value->isValueSet() || !value->isValueExact())
+                return false;
+
+            if (!labels->contains(value->value()))
+                labels->insert(value->value(), qMakePair(rhs, clazz));
+        }
+    }
+
+    return !discriminator->isEmpty();
+}
+
+static void polymorphic_handler_result(TextBuffer &s, const AbstractMetaClass *clazz, const char *indent) {
+    s << indent << "*class_name = \"" << clazz->name() << "\";" << endl
+    << indent << "*package    = \"" << clazz->package().replace(".", "/") << "/\";" << endl
+    << indent << "return true;" << endl;
+}
+
+QStringList MetaInfoGenerator::writePolymorphicHandler(TextBuffer &s, const QString &package,
         const AbstractMetaClassList &classes) {
+    // Sort the classes of the package under each polymorphic base they
+    // inherit from in one pass, instead of scanning all classes per base.
+    QHash<const AbstractMetaClass *, AbstractMetaClassList> subclasses;
+    foreach(AbstractMetaClass *clazz, this->classes()) {
+        if (clazz->package() != package)
+            continue;
+        for (const AbstractMetaClass *base = clazz; base != 0; base = base->baseClass()) {
+            if (base->typeEntry()->isPolymorphicBase())
+                subclasses[base] << clazz;
+        }
+    }
+
     QStringList handlers;
     foreach(AbstractMetaClass *cls, classes) {
         const ComplexTypeEntry *centry = cls->typeEntry();
         if (!centry->isPolymorphicBase())
             continue;
 
-        AbstractMetaClassList classList = this->classes();
-        bool first = true;
-        foreach(AbstractMetaClass *clazz, classList) {
-            if (clazz->package() == package && clazz->inheritsFrom(cls)) {
-                if (!clazz->typeEntry()->polymorphicIdValue().isEmpty()) {
-                    // On first find, open the function
-                    if (first) {
-                        first = false;
-
-                        QString handler = jni_signature(cls->fullName(), Underscores);
-                        handlers.append(handler);
-
-                        s << "static bool polymorphichandler_" << handler
-                        << "(const void *ptr, const char **class_name, const char **package)" << endl
-                        << "{" << endl
-                        << "    Q_ASSERT(ptr != 0);" << endl
-                        << "    " << cls->qualifiedCppName() << " *object = ("
-                        << cls->qualifiedCppName() << " *)ptr;" << endl;
-                    }
+        AbstractMetaClassList identified;
+        foreach(AbstractMetaClass *clazz, subclasses.value(cls)) {
+            if (!clazz->typeEntry()->polymorphicIdValue().isEmpty()) {
+                identified << clazz;
+            } else {
+                QString warning = QString("class '%1' inherits from polymorphic class '%2', but has no polymorphic id set")
+                                  .arg(clazz->name())
+                                  .arg(cls->name());
 
-                    // For each, add case label
-                    s << "    if ("
-                    << clazz->typeEntry()->polymorphicIdValue().replace("%1", "object")
-                    << ") {" << endl
-                    << "        *class_name = \"" << clazz->name() << "\";" << endl
-                    << "        *package    = \"" << clazz->package().replace(".", "/") << "/\";" << endl
-                    << "        return true;" << endl
-                    << "    }" << endl;
-                } else {
-                    QString warning = QString("class '%1' inherits from polymorphic class '%2', but has no polymorphic id set")
-                                      .arg(clazz->name())
-                                      .arg(cls->name());
-
-                    ReportHandler::warning(warning);
-                }
+                ReportHandler::warning(warning);
             }
         }
 
-        // Close the function if it has been opened
-        if (!first) {
-            s << "    return false;" << endl
-            << "}" << endl;
+        if (identified.isEmpty())
+            continue;
+
+        QString handler = jni_signature(cls->fullName(), Underscores);
+        handlers.append(handler);
+
+        s << "static bool polymorphichandler_" << handler
+        << "(const void *ptr, const char **class_name, const char **package)" << endl
+        << "{" << endl
+        << "    Q_ASSERT(ptr != 0);" << endl
+        << "    " << cls->qualifiedCppName() << " *object = ("
+        << cls->qualifiedCppName() << " *)ptr;" << endl;
+
+        QString discriminator;
+        QMap<int, QPair<QString, const AbstractMetaClass *> > labels;
+        if (polymorphicIdSwitch(identified, &discriminator, &labels)) {
+            s << "    switch (" << discriminator.replace("%1", "object") << ") {" << endl;
+            for (QMap<int, QPair<QString, const AbstractMetaClass *> >::const_iterator it = labels.constBegin();
+                    it != labels.constEnd(); ++it) {
+                s << "    case " << it.value().first << ":" << endl;
+                polymorphic_handler_result(s, it.value().second, "        ");
+            }
+            s << "    default:" << endl
+            << "        break;" << endl
+            << "    }" << endl;
+        } else {
+            foreach(const AbstractMetaClass *clazz, identified) {
+                s << "    if ("
+                << clazz->typeEntry()->polymorphicIdValue().replace("%1", "object")
+                << ") {" << endl;
+                polymorphic_handler_result(s, clazz, "        ");
+                s << "    }" << endl;
+            }
         }
+
+        s << "    return false;" << endl
+        << "}" << endl;
     }
 
     return handlers;
 }
 
+/**
+ * Returns the enum and flags types the generated code may convert to Java,
+ * sorted by Java name. The position of a type in this list is its index in
+ * the class handle table.
+ */
+QList<const TypeEntry *> MetaInfoGenerator::classHandleEntries() const {
+    QMap<QString, const TypeEntry *> sorted;
+    TypeEntryHash entries = TypeDatabase::instance()->allEntries();
+    for (TypeEntryHash::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        foreach(const TypeEntry *entry, it.value()) {
+            if (entry->isEnum() || entry->isFlags())
+                sorted.insert(CppImplGenerator::classHandleJavaName(entry), entry);
+        }
+    }
+    return sorted.values();
+}
+
+void MetaInfoGenerator::writeClassHandleDeclarations(TextBuffer &s, const QString &package) {
+    QString function = "__qt_from_class_handle_" + QString(package).replace(".", "_");
+
+    s << "#include <qtjambi/qtjambi_global.h>" << endl << endl
+    << "enum QtJambiClassHandle {" << endl;
+    foreach(const TypeEntry *entry, classHandleEntries())
+        s << "    " << CppImplGenerator::classHandleName(entry) << "," << endl;
+    s << "    __class_handle_count" << endl
+    << "};" << endl << endl
+    << "jobject " << function << "(JNIEnv *env, int value, int handle);" << endl << endl
+    << "static inline jobject qtjambi_from_class_handle(JNIEnv *env, int value, int handle)" << endl
+    << "{" << endl
+    << "    return " << function << "(env, value, handle);" << endl
+    << "}" << endl << endl;
+}
+
+/**
+ * Returns the method names and signatures the shell classes of \a package
+ * pass to qtjambi_setup_vtable(), once each and sorted.
+ */
+QStringList MetaInfoGenerator::methodPoolStrings(const QString &package) const {
+    QSet<QString> strings;
+    foreach(const AbstractMetaClass *cls, classes()) {
+        if (cls->package() != package)
+            continue;
+
+        AbstractMetaFunctionList functions = cls->virtualFunctions() + cls->cppInconsistentFunctions();
+        foreach(const AbstractMetaFunction *function, functions) {
+            strings.insert(function->name());
+            strings.insert(jni_signature(function, SlashesAndStuff));
+        }
+    }
+
+    QStringList sorted = strings.toList();
+    qSort(sorted);
+    return sorted;
+}
+
+void MetaInfoGenerator::writeMethodPoolDeclarations(TextBuffer &s, const QString &package) {
+    s << "extern const char " << CppImplGenerator::methodPoolName(package) << "[];" << endl << endl
+    << "enum QtJambiMethodPoolOffset {" << endl;
+
+    int offset = 0;
+    foreach(const QString &string, methodPoolStrings(package)) {
+        s << "    " << CppImplGenerator::methodPoolOffsetName(string) << " = " << offset << "," << endl;
+        offset += string.toLatin1().size() + 1;
+    }
+
+    s << "    __method_pool_size = " << offset << endl
+    << "};" << endl << endl;
+}
+
+/**
+ * Writes the string pool the shell classes of a package take their
+ * method names and signatures from, so each appears once per library.
+ */
+void MetaInfoGenerator::writeMethodPool(TextBuffer &s, const QString &package) {
+    QStringList strings = methodPoolStrings(package);
+
+    s << "const char " << CppImplGenerator::methodPoolName(package) << "[] =";
+    if (strings.isEmpty())
+        s << " \"\"";
+    foreach(const QString &string, strings)
+        s << endl << "    \"" << string.toLatin1() << "\\0\"";
+    s << ";" << endl << endl;
+}
+
+/**
+ * Returns the classes of \a package whose native functions CppImplGenerator
+ * registers through a JNINativeMethod table.
+ */
+AbstractMetaClassList MetaInfoGenerator::registerNativesClasses(const QString &package) const {
+    AbstractMetaClassList registered;
+    foreach(AbstractMetaClass *cls, classes()) {
+        if (cls->package() == package && CppGenerator::generatesNativeCode(cls))
+            registered << cls;
+    }
+    return registered;
+}
+
+void MetaInfoGenerator::writeRegisterNativesDeclarations(TextBuffer &s, const QString &package) {
+    s << "#include <qtjambi/qtjambi_global.h>" << endl << endl
+    << "void " << CppImplGenerator::registerNativesHelperName(package)
+    << "(JNIEnv *env, const char *className, JNINativeMethod *methods, int count);" << endl;
+    foreach(const AbstractMetaClass *cls, registerNativesClasses(package))
+        s << "void " << CppImplGenerator::registerNativesFunctionName(cls) << "(JNIEnv *env);" << endl;
+    s << endl;
+}
+
+/**
+ * Writes the function the classes of a package register their native
+ * methods with. A class that is not found, or that lacks one of the
+ * methods, is skipped or registered method by method rather than failing
+ * the whole library.
+ */
+void MetaInfoGenerator::writeRegisterNativesHelper(TextBuffer &s, const QString &package) {
+    s << "void " << CppImplGenerator::registerNativesHelperName(package)
+    << "(JNIEnv *env, const char *className, JNINativeMethod *methods, int count)" << endl
+    << "{" << endl
+    << "    jclass clazz = qtjambi_find_class(env, className);" << endl
+    << "    if (clazz == 0) {" << endl
+    << "        env->ExceptionClear();" << endl
+    << "        return;" << endl
+    << "    }" << endl
+    << endl
+    << "    if (env->RegisterNatives(clazz, methods, count) != 0) {" << endl
+    << "        env->ExceptionClear();" << endl
+    << "        for (int i=0; i<count; ++i) {" << endl
+    << "            if (env->RegisterNatives(clazz, methods + i, 1) != 0) {" << endl
+    << "                qWarning(\"RegisterNatives: %s.%s%s not found\", className," << endl
+    << "                         methods[i].name, methods[i].signature);" << endl
+    << "                env->ExceptionClear();" << endl
+    << "            }" << endl
+    << "        }" << endl
+    << "    }" << endl
+    << "    env->DeleteLocalRef(clazz);" << endl
+    << "}" << endl << endl;
+}
+
+/**
+ * Writes the class handle table of a package. Each entry resolves its
+ * class and the method that wraps an int in it the first time it is used
+ * and keeps them for the lifetime of the library.
+ */
+void MetaInfoGenerator::writeClassHandleTable(TextBuffer &s, const QString &package) {
+    s << "struct QtJambiClassHandleEntry {" << endl
+    << "    const char *className;" << endl
+    << "    const char *resolveSignature;" << endl
+    << "    QBasicAtomicInt resolved;" << endl
+    << "    jclass clazz;" << endl
+    << "    jmethodID method;" << endl
+    << "};" << endl << endl
+    << "static QtJambiClassHandleEntry qtjambi_class_handles[] = {" << endl;
+
+    foreach(const TypeEntry *entry, classHandleEntries()) {
+        QString className = CppImplGenerator::classHandleJavaName(entry);
+        s << "    { \"" << className << "\", ";
+        // Flags are constructed from the int, enums are looked up by it
+        if (entry->isFlags())
+            s << "0";
+        else
+            s << "\"(I)L" << className << ";\"";
+        s << ", Q_BASIC_ATOMIC_INITIALIZER(0), 0, 0 }," << endl;
+    }
+
+    s << "    { 0, 0, Q_BASIC_ATOMIC_INITIALIZER(0), 0, 0 }" << endl
+    << "};" << endl << endl
+    << "Q_GLOBAL_STATIC(QMutex, qtjambi_class_handle_mutex)" << endl << endl
+    << "jobject __qt_from_class_handle_" << QString(package).replace(".", "_")
+    << "(JNIEnv *env, int value, int handle)" << endl
+    << "{" << endl
+    << "    Q_ASSERT(handle >= 0 && handle < __class_handle_count);" << endl
+    << "    QtJambiClassHandleEntry &entry = qtjambi_class_handles[handle];" << endl
+    << "    if (!entry.resolved.testAndSetAcquire(1, 1)) {" << endl
+    << "        QMutexLocker locker(qtjambi_class_handle_mutex());" << endl
+    << "        if (entry.clazz == 0) {" << endl
+    << "            jclass clazz = qtjambi_find_class(env, entry.className);" << endl
+    << "            if (clazz == 0)" << endl
+    << "                return 0;" << endl
+    << "            entry.method = entry.resolveSignature != 0" << endl
+    << "                           ? env->GetStaticMethodID(clazz, \"resolve\", entry.resolveSignature)" << endl
+    << "                           : env->GetMethodID(clazz, \"<init>\", \"(I)V\");" << endl
+    << "            if (entry.method == 0) {" << endl
+    << "                env->DeleteLocalRef(clazz);" << endl
+    << "                return 0;" << endl
+    << "            }" << endl
+    << "            entry.clazz = (jclass) env->NewGlobalRef(clazz);" << endl
+    << "            env->DeleteLocalRef(clazz);" << endl
+    << "        }" << endl
+    << "        entry.resolved.fetchAndStoreRelease(1);" << endl
+    << "    }" << endl
+    << endl
+    << "    if (entry.resolveSignature != 0)" << endl
+    << "        return env->CallStaticObjectMethod(entry.clazz, entry.method, value);" << endl
+    << "    return env->NewObject(entry.clazz, entry.method, value);" << endl
+    << "}" << endl << endl;
+}
+
 // This is only needed when qtJambiDebugTools() is set
-void MetaInfoGenerator::writeNameLiteral(QTextStream &s, const TypeEntry *entry, const QString &fileName) {
+void MetaInfoGenerator::writeNameLiteral(TextBuffer &s, const TypeEntry *entry, const QString &fileName) {
     static QSet<QString> used;
 
     const QString key (fileName + ":" + entry->name());
@@ -405,6 +758,12 @@ void MetaInfoGenerator::writeCppFile() {
         if (f != 0) {
             writeSignalsAndSlots(f->stream, package);
             writeEnums(f->stream, package);
+            if (classHandleTable())
+                writeClassHandleTable(f->stream, package);
+            if (methodPool())
+                writeMethodPool(f->stream, package);
+            if (registerNatives())
+                writeRegisterNativesHelper(f->stream, package);
             handlers_to_register[package] = writePolymorphicHandler(f->stream, package, classes_with_polymorphic_id);
         }
     }
@@ -481,6 +840,12 @@ void MetaInfoGenerator::writeHeaderFile() {
             FileOut file(cppOutputDirectory() + "/" + subDirectoryForClass(cls, CppDirectory) + "/" + headerFilename());
             file.stream << "#ifndef " << filenameStub().toUpper() << "_H" << endl;
             file.stream << "#define " << filenameStub().toUpper() << "_H" << endl << endl;
+            if (classHandleTable())
+                writeClassHandleDeclarations(file.stream, cls->package());
+            if (methodPool())
+                writeMethodPoolDeclarations(file.stream, cls->package());
+            if (registerNatives())
+                writeRegisterNativesDeclarations(file.stream, cls->package());
             writeInitializationFunctionName(file.stream, cls->package(), true);
             file.stream << ";" << endl << "#endif" << endl << endl;
 
@@ -496,7 +861,7 @@ void MetaInfoGenerator::writeHeaderFile() {
     }
 }
 
-void MetaInfoGenerator::writeCodeBlock(QTextStream &s, const QString &code) {
+void MetaInfoGenerator::writeCodeBlock(TextBuffer &s, const QString &code) {
     QStringList lines = code.split('\n');
     QString indent;
     foreach(QString str, lines) {
@@ -519,7 +884,7 @@ const AbstractMetaClass* MetaInfoGenerator::lookupClassWithPublicDestructor(cons
     return 0;
 }
 
-void MetaInfoGenerator::writeDestructors(QTextStream &s, const AbstractMetaClass *cls) {
+void MetaInfoGenerator::writeDestructors(TextBuffer &s, const AbstractMetaClass *cls) {
     // We can only delete classes with public destructors
     const AbstractMetaClass *clsWithPublicDestructor = lookupClassWithPublicDestructor(cls);
     if (clsWithPublicDestructor != 0) {
@@ -541,7 +906,7 @@ void MetaInfoGenerator::writeDestructors(QTextStream &s, const AbstractMetaClass
     }
 }
 
-void MetaInfoGenerator::writeCustomStructors(QTextStream &s, const TypeEntry *entry) {
+void MetaInfoGenerator::writeCustomStructors(TextBuffer &s, const TypeEntry *entry) {
     if (!entry->preferredConversion())
         return ;
 
@@ -566,7 +931,7 @@ void MetaInfoGenerator::writeCustomStructors(QTextStream &s, const TypeEntry *en
     }
 }
 
-static void generateInitializer(QTextStream &s, const QString &package, CodeSnip::Position pos) {
+static void generateInitializer(TextBuffer &s, const QString &package, CodeSnip::Position pos) {
     QList<CodeSnip> snips =
         ((TypeSystemTypeEntry *) TypeDatabase::instance()->findType(package))->snips;
 
@@ -597,15 +962,19 @@ void MetaInfoGenerator::writeLibraryInitializers() {
 
             QString signature = jni_function_signature(package, "QtJambi_LibraryInitializer",
                                 "__qt_initLibrary", "void");
-            QTextStream &s = fileOut.stream;
+            TextBuffer &s = fileOut.stream;
             s << "#include \"metainfo.h\"" << endl
             << "#include <qtjambi/qtjambi_global.h>" << endl << endl
-            << signature << "(JNIEnv *, jclass)" << endl
+            << signature << "(JNIEnv *" << (registerNatives() ? "__jni_env" : "") << ", jclass)" << endl
             << "{" << endl
             << "    ";
             writeInitializationFunctionName(s, package, false);
-            s << ";" << endl
-            << "}" << endl << endl;
+            s << ";" << endl;
+            if (registerNatives()) {
+                foreach(const AbstractMetaClass *cls, registerNativesClasses(package))
+                    s << "    " << CppImplGenerator::registerNativesFunctionName(cls) << "(__jni_env);" << endl;
+            }
+            s << "}" << endl << endl;
 
             QString pro_file_name = QString(package).replace(".", "_");
 
@@ -620,7 +989,7 @@ void MetaInfoGenerator::writeLibraryInitializers() {
 
             FileOut fileOut(javaOutputDirectory() + "/" + subDirectoryForPackage(package, JavaDirectory) + "/QtJambi_LibraryInitializer.java");
 
-            QTextStream &s = fileOut.stream;
+            TextBuffer &s = fileOut.stream;
             s << "package " << package << ";" << endl << endl
             << "class QtJambi_LibraryInitializer" << endl
             << "{" << endl
@@ -657,7 +1026,7 @@ void MetaInfoGenerator::writeLibraryInitializers() {
     }
 }
 
-void MetaInfoGenerator::writeInclude(QTextStream &s, const Include &inc, QSet<QString> &dedupe) {
+void MetaInfoGenerator::writeInclude(TextBuffer &s, const Include &inc, QSet<QString> &dedupe) {
     if (inc.name.isEmpty())
         return;
 
@@ -675,7 +1044,7 @@ void MetaInfoGenerator::writeInclude(QTextStream &s, const Include &inc, QSet<QS
     s << "#include " << incString << endl;
 }
 
-void MetaInfoGenerator::writeIncludeStatements(QTextStream &s, const AbstractMetaClassList &classList,
+void MetaInfoGenerator::writeIncludeStatements(TextBuffer &s, const AbstractMetaClassList &classList,
         const QString &package) {
     QSet<QString> dedupe = QSet<QString>();
 
@@ -687,6 +1056,8 @@ void MetaInfoGenerator::writeIncludeStatements(QTextStream &s, const AbstractMet
     writeInclude(s, Include(Include::IncludePath, "QtCore/QReadWriteLock"), dedupe);
     writeInclude(s, Include(Include::IncludePath, "QtCore/QReadLocker"), dedupe);
     writeInclude(s, Include(Include::IncludePath, "QtCore/QWriteLocker"), dedupe);
+    if (classHandleTable())
+        writeInclude(s, Include(Include::IncludePath, "QtCore/QMutex"), dedupe);
     writeInclude(s, Include(Include::IncludePath, "qtjambi/qtjambi_cache.h"), dedupe);
     writeInclude(s, Include(Include::IncludePath, "qtjambi/qtjambi_core.h"), dedupe);
 
@@ -708,13 +1079,13 @@ void MetaInfoGenerator::writeIncludeStatements(QTextStream &s, const AbstractMet
     }
 }
 
-void MetaInfoGenerator::writeInitializationFunctionName(QTextStream &s, const QString &package, bool fullSignature) {
+void MetaInfoGenerator::writeInitializationFunctionName(TextBuffer &s, const QString &package, bool fullSignature) {
     if (fullSignature)
         s << "void ";
     s << "__metainfo_init_" << QString(package).replace(".", "_") << "()";
 }
 
-void MetaInfoGenerator::writeInitialization(QTextStream &s, const TypeEntry *entry, const AbstractMetaClass *cls,
+void MetaInfoGenerator::writeInitialization(TextBuffer &s, const TypeEntry *entry, const AbstractMetaClass *cls,
         bool registerMetaType) {
     if (entry->codeGeneration() == TypeEntry::GenerateForSubclass)
         return;
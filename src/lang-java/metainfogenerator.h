@@ -59,7 +59,7 @@ class MetaInfoGenerator : public JavaGenerator {
 
         virtual void generate();
         virtual QString fileNameForClass(const AbstractMetaClass *java_class) const;
-        virtual void write(QTextStream &s, const AbstractMetaClass *java_class);
+        virtual void write(TextBuffer &s, const AbstractMetaClass *java_class);
 
         void setFilenameStub(const QString &stub) { m_filenameStub = stub; }
         QString filenameStub() const { return m_filenameStub; }
@@ -91,27 +91,49 @@ class MetaInfoGenerator : public JavaGenerator {
         bool qtJambiDebugTools() const { return m_qtjambi_debug_tools; }
         void setQtJambiDebugTools(bool bf) { m_qtjambi_debug_tools = bf; }
 
+        bool classHandleTable() const { return m_class_handle_table; }
+        void setClassHandleTable(bool b) { m_class_handle_table = b; }
+
+        bool methodPool() const { return m_method_pool; }
+        void setMethodPool(bool b) { m_method_pool = b; }
+
+        bool registerNatives() const { return m_register_natives; }
+        void setRegisterNatives(bool b) { m_register_natives = b; }
+
     private:
         void writeCppFile();
         void writeHeaderFile();
         void writeLibraryInitializers();
-        void writeInclude(QTextStream &s, const Include &inc, QSet<QString> &dedupe);
-        void writeIncludeStatements(QTextStream &s, const AbstractMetaClassList &classList, const QString &package);
-        void writeInitializationFunctionName(QTextStream &s, const QString &package, bool fullSignature);
-        void writeInitialization(QTextStream &s, const TypeEntry *entry, const AbstractMetaClass *cls, bool registerMetaType = true);
-        void writeCustomStructors(QTextStream &s, const TypeEntry *entry);
-        void writeDestructors(QTextStream &s, const AbstractMetaClass *cls);
-        void writeCodeBlock(QTextStream &s, const QString &code);
-        void writeSignalsAndSlots(QTextStream &s, const QString &package);
-        void writeEnums(QTextStream &s, const QString &package);
-        void writeRegisterSignalsAndSlots(QTextStream &s);
-        void writeRegisterEnums(QTextStream &s);
-        QStringList writePolymorphicHandler(QTextStream &s, const QString &package, const AbstractMetaClassList &clss);
+        void writeInclude(TextBuffer &s, const Include &inc, QSet<QString> &dedupe);
+        void writeIncludeStatements(TextBuffer &s, const AbstractMetaClassList &classList, const QString &package);
+        void writeInitializationFunctionName(TextBuffer &s, const QString &package, bool fullSignature);
+        void writeInitialization(TextBuffer &s, const TypeEntry *entry, const AbstractMetaClass *cls, bool registerMetaType = true);
+        void writeCustomStructors(TextBuffer &s, const TypeEntry *entry);
+        void writeDestructors(TextBuffer &s, const AbstractMetaClass *cls);
+        void writeCodeBlock(TextBuffer &s, const QString &code);
+        void writeSignalsAndSlots(TextBuffer &s, const QString &package);
+        void writeEnums(TextBuffer &s, const QString &package);
+        void writeRegisterSignalsAndSlots(TextBuffer &s);
+        void writeRegisterEnums(TextBuffer &s);
+        QStringList writePolymorphicHandler(TextBuffer &s, const QString &package, const AbstractMetaClassList &clss);
+        bool polymorphicIdSwitch(const AbstractMetaClassList &subclasses, QString *discriminator,
+                                 QMap<int, QPair<QString, const AbstractMetaClass *> > *labels) const;
+        void writeClassHandleTable(TextBuffer &s, const QString &package);
+        void writeClassHandleDeclarations(TextBuffer &s, const QString &package);
+        QList<const TypeEntry *> classHandleEntries() const;
+        void writeMethodPool(TextBuffer &s, const QString &package);
+        void writeMethodPoolDeclarations(TextBuffer &s, const QString &package);
+        QStringList methodPoolStrings(const QString &package) const;
+        void writeRegisterNativesHelper(TextBuffer &s, const QString &package);
+        void writeRegisterNativesDeclarations(TextBuffer &s, const QString &package);
+        AbstractMetaClassList registerNativesClasses(const QString &package) const;
         bool shouldGenerate(const TypeEntry *entry) const;
         void buildSkipList();
+        AbstractMetaClassList metaInfoPackageClasses() const;
+        QByteArray metaInfoFingerprint() const;
 
         // This is only needed when qtJambiDebugTools() is set
-        void writeNameLiteral(QTextStream &, const TypeEntry *, const QString &fileName);
+        void writeNameLiteral(TextBuffer &, const TypeEntry *, const QString &fileName);
 
         QHash<QString, int> m_skip_list;
         QString m_filenameStub;
@@ -126,6 +148,9 @@ class MetaInfoGenerator : public JavaGenerator {
         QString m_java_out_dir;
 
         bool m_qtjambi_debug_tools;
+        bool m_class_handle_table;
+        bool m_method_pool;
+        bool m_register_natives;
 };
 
 #endif // METAINFOGENERATOR_H
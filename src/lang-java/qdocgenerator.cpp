@@ -63,7 +63,7 @@ void QDocGenerator::generate() {
         return;
     }
 
-    QTextStream s(&f);
+    TextBuffer s;
     s << "<japi>" << endl;
 
     AbstractMetaClassList clazzes = classes();
@@ -74,6 +74,9 @@ void QDocGenerator::generate() {
     }
 
     s << "</japi>" << endl;
+
+    QTextStream out(&f);
+    out << s.string();
 }
 
 // copy-paste from linguist/shared/metatranslator.cpp
@@ -113,7 +116,7 @@ static QString protect(const QByteArray& str) {
 }
 
 
-void QDocGenerator::write(QTextStream &s, const AbstractMetaFunction *java_function) {
+void QDocGenerator::write(TextBuffer &s, const AbstractMetaFunction *java_function) {
     AbstractMetaArgumentList arguments = java_function->arguments();
     int argument_count = arguments.size();
 
@@ -129,7 +132,7 @@ void QDocGenerator::write(QTextStream &s, const AbstractMetaFunction *java_funct
     }
 }
 
-void QDocGenerator::writeOverload(QTextStream &s,
+void QDocGenerator::writeOverload(TextBuffer &s,
                                   const AbstractMetaFunction *java_function,
                                   int arg_count) {
     if (java_function->isModifiedRemoved(TypeSystem::TargetLangCode))
@@ -220,13 +223,13 @@ void QDocGenerator::writeOverload(QTextStream &s,
     s << "</method>" << endl;
 }
 
-void QDocGenerator::write(QTextStream &s, const AbstractMetaEnumValue *java_enum_value) {
+void QDocGenerator::write(TextBuffer &s, const AbstractMetaEnumValue *java_enum_value) {
     s << "<enum-value java=\"" << protect(java_enum_value->name().toUtf8()) << "\"" << endl
     << "            cpp=\"" << protect(java_enum_value->name().toUtf8()) << "\"" << endl
     << "            value=\"" << java_enum_value->value() << "\"/>" << endl;
 }
 
-void QDocGenerator::write(QTextStream &s, const AbstractMetaEnum *java_enum) {
+void QDocGenerator::write(TextBuffer &s, const AbstractMetaEnum *java_enum) {
     s << "<enum java=\"" << protect(java_enum->name().toUtf8()) << "\"" << endl
     << "      cpp=\"" << protect(java_enum->name().toUtf8()) << "\"" << endl;
 
@@ -243,13 +246,13 @@ void QDocGenerator::write(QTextStream &s, const AbstractMetaEnum *java_enum) {
     s << "</enum>" << endl;
 }
 
-void QDocGenerator::writeSignal(QTextStream &s, const AbstractMetaFunction *java_function) {
+void QDocGenerator::writeSignal(TextBuffer &s, const AbstractMetaFunction *java_function) {
     s << "<signal java=\""
     << protect(java_function->targetLangSignature().toUtf8()) << "\" cpp=\""
     << protect(java_function->signature().toUtf8()) << "\"/>" << endl;
 }
 
-void QDocGenerator::write(QTextStream &s, const AbstractMetaField *java_field) {
+void QDocGenerator::write(TextBuffer &s, const AbstractMetaField *java_field) {
     uint included_attributes = NoBlockedSlot;
     uint excluded_attributes = 0;
     setupForFunction(java_field->getter(), &included_attributes, &excluded_attributes);
@@ -265,7 +268,7 @@ void QDocGenerator::write(QTextStream &s, const AbstractMetaField *java_field) {
     << "    cpp=\"" << protect(java_field->name().toUtf8()) << "\" />" << endl;
 }
 
-void QDocGenerator::write(QTextStream &s, const AbstractMetaClass *java_class) {
+void QDocGenerator::write(TextBuffer &s, const AbstractMetaClass *java_class) {
     s << "<class" << endl
     << "   java=\"" << protect(java_class->name().toUtf8()) << "\"" << endl
     << "   cpp=\"" << protect(java_class->typeEntry()->qualifiedCppName().toUtf8()) << "\"" << endl
@@ -47,13 +47,13 @@ class QDocGenerator: public JavaGenerator {
         virtual void generate();
         virtual QString subDirectoryForClass(const AbstractMetaClass *java_class) const;
         virtual QString fileNameForClass(const AbstractMetaClass *java_class) const;
-        virtual void write(QTextStream &s, const AbstractMetaClass *java_class);
-        virtual void write(QTextStream &s, const AbstractMetaEnumValue *java_enum_value);
-        virtual void write(QTextStream &s, const AbstractMetaEnum *java_enum);
-        virtual void writeOverload(QTextStream &s, const AbstractMetaFunction *java_function, int arg_count);
-        virtual void write(QTextStream &s, const AbstractMetaFunction *java_function);
-        virtual void write(QTextStream &s, const AbstractMetaField *java_field);
-        virtual void writeSignal(QTextStream &s, const AbstractMetaFunction *java_function);
+        virtual void write(TextBuffer &s, const AbstractMetaClass *java_class);
+        virtual void write(TextBuffer &s, const AbstractMetaEnumValue *java_enum_value);
+        virtual void write(TextBuffer &s, const AbstractMetaEnum *java_enum);
+        virtual void writeOverload(TextBuffer &s, const AbstractMetaFunction *java_function, int arg_count);
+        virtual void write(TextBuffer &s, const AbstractMetaFunction *java_function);
+        virtual void write(TextBuffer &s, const AbstractMetaField *java_field);
+        virtual void writeSignal(TextBuffer &s, const AbstractMetaFunction *java_function);
 };
 
 #endif // QDOC_GENERATOR
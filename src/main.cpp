@@ -39,9 +39,12 @@
 #include "preprocesshandler.h"
 
 bool Preprocess::preprocess(const QString& sourceFile, const QString& targetFile, const QString& phononinclude,
- const QStringList& includePathList, const QStringList& inputDirectoryList, int verbose) {
+ const QStringList& includePathList, const QStringList& inputDirectoryList, int verbose, QStringList *includedFiles) {
     PreprocessHandler handler(sourceFile, targetFile, phononinclude, includePathList, inputDirectoryList, verbose);
-    return handler.handler();
+    bool ok = handler.handler();
+    if (includedFiles)
+        *includedFiles = handler.includedFiles;
+    return ok;
 }
 
 int main(int argc, char *argv[]) {
@@ -45,7 +45,8 @@
 
 struct Preprocess {
     static bool preprocess(const QString &sourceFile, const QString &targetFile, const QString &phononinclude = QString(),
-        const QStringList &includePathList = QStringList(), const QStringList &inputDirectoryList = QStringList(), int verbose = 0);
+        const QStringList &includePathList = QStringList(), const QStringList &inputDirectoryList = QStringList(), int verbose = 0,
+        QStringList *includedFiles = 0);
 };
 
 extern QString resolveFilePath(const QString &fileName, int opts, const QStringList &list);
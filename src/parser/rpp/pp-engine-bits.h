@@ -188,6 +188,16 @@ namespace rpp {
 #endif
 
                 env.current_line = 1;
+                process(first, last, result);
+            }
+
+            /**
+             * Preprocesses the given range as a continuation of the current
+             * file: env.current_line and the #if state are kept as they are.
+             * Used to resume the master include after a restored snapshot.
+             */
+            template <typename _InputIterator, typename _OutputIterator>
+            void process(_InputIterator first, _InputIterator last, _OutputIterator result) {
                 char buffer[512];
 
                 while (true) {
@@ -353,6 +363,8 @@ namespace rpp {
 
 
             std::vector<std::string> include_paths;
+            /** Every header opened through #include, in the order it was read. */
+            std::vector<std::string> included_files;
             pp_skip_blanks skip_blanks;
             pp_skip_comment_or_divop skip_comment_or_divop;
             enum { MAX_LEVEL = 512 };
@@ -503,6 +515,7 @@ namespace rpp {
 #endif
 
                 if (fp != 0) {
+                    included_files.push_back(filepath);
                     std::string old_file = env.current_file;
                     env.current_file = filepath;
                     int __saved_lines = env.current_line;
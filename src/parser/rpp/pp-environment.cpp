@@ -41,6 +41,14 @@ void rpp::pp_environment::unbind(char const *__s, std::size_t __size) {
     unbind(&__tmp);
 }
 
+void rpp::pp_environment::clear() {
+    for (std::size_t i = 0; i < _M_macros.size(); ++i)
+        delete _M_macros [i];
+    _M_macros.clear();
+
+    memset(_M_base, 0, _M_hash_size * sizeof(pp_macro*));
+}
+
 rpp::pp_macro *rpp::pp_environment::resolve(pp_fast_string const *p_name) const {
     std::size_t h = hash_code(*p_name) % _M_hash_size;
     pp_macro *it = _M_base [h];
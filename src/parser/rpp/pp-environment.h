@@ -77,6 +77,11 @@ namespace rpp {
 
             void unbind(char const *__s, std::size_t __size);
 
+            /**
+             * Drops every macro, hidden ones included.
+             */
+            void clear();
+
             /**
              * Find corresponding pp_macro from hash table.
              */
@@ -3,6 +3,10 @@
 #include <QStringList>
 #include <QDir>
 #include <QDebug>
+#include <QDateTime>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QSet>
 
 #include <cstdio>
 
@@ -59,6 +63,7 @@ bool PreprocessHandler::handler() {
 
     QByteArray ba = file.readAll();
     file.close();
+    configText = ba;
 
 // FIXME: Dump empty at start
 // FIXME: If any debug mode, enable showing DEFINE/UNDEF/INCLUDE(summary/verbose)
@@ -95,8 +100,20 @@ void PreprocessHandler::writeTargetFile(QString sourceFile, QString targetFile,
     result += "\"\n";
 
     qDebug() << "Processing source" << sourceInfo.absolutePath() << sourceInfo.fileName();
-    preprocess.file(toStdString(sourceInfo.fileName()),
-                    rpp::pp_output_iterator<std::string> (result));
+    if (Wrapper::pp_snapshot_file.isEmpty()) {
+        preprocess.file(toStdString(sourceInfo.fileName()),
+                        rpp::pp_output_iterator<std::string> (result));
+    } else {
+        processWithSnapshot(sourceInfo, &result);
+    }
+
+    // Included paths may be relative to the master include's directory.
+    includedFiles << sourceInfo.absoluteFilePath();
+    for (std::size_t i = 0; i < preprocess.included_files.size(); ++i) {
+        QString path = QFileInfo(fromStdString(preprocess.included_files[i])).absoluteFilePath();
+        if (!includedFiles.contains(path))
+            includedFiles << path;
+    }
 
     QDir::setCurrent(currentDir);
 
@@ -107,6 +124,308 @@ void PreprocessHandler::writeTargetFile(QString sourceFile, QString targetFile,
     f.write(result.c_str(), result.length());
 }
 
+static const quint32 PP_SNAPSHOT_MAGIC = 0x51505053;
+static const quint32 PP_SNAPSHOT_VERSION = 1;
+
+struct SnapshotInput {
+    QString path;
+    qint64 size;
+    uint modified;
+    QByteArray hash;
+};
+
+struct SnapshotMacro {
+    QByteArray name;
+    bool defined;
+    QByteArray definition;
+    QList<QByteArray> formals;
+    quint32 state;
+    qint32 lines;
+};
+
+static QByteArray file_hash(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return QCryptographicHash::hash(file.readAll(), QCryptographicHash::Sha1);
+}
+
+/**
+ * An input is unchanged when its size and mtime match; if only the mtime
+ * moved (a touch or a fresh checkout) the content hash decides.
+ */
+static bool snapshot_input_unchanged(const SnapshotInput &input) {
+    QFileInfo info(input.path);
+    if (!info.isFile() || info.size() != input.size)
+        return false;
+    if (info.lastModified().toTime_t() == input.modified)
+        return true;
+    return file_hash(input.path) == input.hash;
+}
+
+/**
+ * Returns the byte offset just past the first \a lines lines of \a text,
+ * or the whole text when \a lines is 0.
+ */
+static int snapshot_split_offset(const QByteArray &text, int lines) {
+    if (lines <= 0)
+        return text.size();
+
+    int pos = 0;
+    for (int i = 0; i < lines && pos < text.size(); ++i) {
+        int eol = text.indexOf('\n', pos);
+        if (eol < 0)
+            return text.size();
+        pos = eol + 1;
+    }
+    return pos;
+}
+
+/**
+ * Returns true when \a text can be cut at \a split without leaving the
+ * prefix inside a block comment or on a line ended by a backslash
+ * continuation; either would hand both halves a broken token stream.
+ */
+static bool snapshot_split_is_clean(const QByteArray &text, int split) {
+    bool inComment = false;
+    for (int i = 0; i < split; ++i) {
+        char c = text.at(i);
+        char next = i + 1 < split ? text.at(i + 1) : '\0';
+        if (inComment) {
+            if (c == '*' && next == '/') {
+                inComment = false;
+                ++i;
+            }
+        } else if (c == '/' && next == '*') {
+            inComment = true;
+            ++i;
+        } else if (c == '/' && next == '/') {
+            while (i < split && text.at(i) != '\n')
+                ++i;
+        } else if (c == '"' || c == '\'') {
+            for (++i; i < split && text.at(i) != c && text.at(i) != '\n'; ++i) {
+                if (text.at(i) == '\\')
+                    ++i;
+            }
+        }
+    }
+    if (inComment)
+        return false;
+
+    int end = split;
+    if (end > 0 && text.at(end - 1) == '\n')
+        --end;
+    if (end > 0 && text.at(end - 1) == '\r')
+        --end;
+    return end == 0 || text.at(end - 1) != '\\';
+}
+
+static QByteArray to_byte_array(rpp::pp_fast_string const *s) {
+    return QByteArray(s->begin(), int(s->size()));
+}
+
+static rpp::pp_fast_string const *to_symbol(const QByteArray &s) {
+    return rpp::pp_symbol::get(s.constData(), std::size_t(s.size()));
+}
+
+void PreprocessHandler::processWithSnapshot(const QFileInfo &sourceInfo, std::string *result) {
+    QFile master(sourceInfo.fileName());
+    if (!master.open(QIODevice::ReadOnly)) {
+        std::fprintf(stderr, "Failed to read master include for snapshot: %s\n", qPrintable(sourceInfo.absoluteFilePath()));
+        preprocess.file(toStdString(sourceInfo.fileName()), rpp::pp_output_iterator<std::string> (*result));
+        return;
+    }
+    QByteArray text = master.readAll();
+    master.close();
+
+    int split = snapshot_split_offset(text, Wrapper::pp_snapshot_lines);
+    if (!snapshot_split_is_clean(text, split)) {
+        std::fprintf(stderr, "Preprocessor snapshot skipped: line %d of %s is inside a comment or continuation\n",
+                     Wrapper::pp_snapshot_lines, qPrintable(sourceInfo.fileName()));
+        preprocess.file(toStdString(sourceInfo.fileName()), rpp::pp_output_iterator<std::string> (*result));
+        return;
+    }
+    QByteArray prefix = text.left(split);
+    QByteArray key = snapshotKey(sourceInfo.absoluteFilePath(), prefix);
+
+    std::string was = env.current_file;
+    env.current_file = toStdString(sourceInfo.fileName());
+
+    std::string prefixText;
+    if (loadSnapshot(Wrapper::pp_snapshot_file, key, &prefixText)) {
+        std::printf("Restored preprocessor snapshot: '%s'\n", qPrintable(Wrapper::pp_snapshot_file));
+        *result += prefixText;
+        env.current_line = prefix.count('\n') + 1;
+        rpp::_PP_internal::output_line(env.current_file, env.current_line,
+                                       rpp::pp_output_iterator<std::string> (*result));
+    } else {
+        std::string::size_type start = result->size();
+        std::size_t firstIncludedFile = preprocess.included_files.size();
+        preprocess.operator()(prefix.constData(), prefix.constData() + prefix.size(),
+                              rpp::pp_output_iterator<std::string> (*result));
+
+        if (preprocess.iflevel != 0) {
+            std::fprintf(stderr, "Preprocessor snapshot not written: line %d of %s is inside #if\n",
+                         Wrapper::pp_snapshot_lines, qPrintable(sourceInfo.fileName()));
+        } else {
+            saveSnapshot(Wrapper::pp_snapshot_file, key, result->substr(start), firstIncludedFile);
+        }
+    }
+
+    preprocess.process(text.constData() + split, text.constData() + text.size(),
+                       rpp::pp_output_iterator<std::string> (*result));
+
+    env.current_file = was;
+}
+
+/**
+ * Everything besides the headers themselves that decides what the prefix
+ * preprocesses to: the configuration, the include paths and the prefix text.
+ */
+QByteArray PreprocessHandler::snapshotKey(const QString &sourcePath, const QByteArray &prefix) const {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(configText);
+    for (std::size_t i = 0; i < preprocess.include_paths.size(); ++i) {
+        hash.addData(preprocess.include_paths[i].c_str(), int(preprocess.include_paths[i].size()) + 1);
+    }
+    hash.addData(sourcePath.toUtf8());
+    hash.addData(prefix);
+    return hash.result();
+}
+
+bool PreprocessHandler::loadSnapshot(const QString &fileName, const QByteArray &key, std::string *text) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_5);
+
+    quint32 magic, version;
+    QByteArray storedKey;
+    stream >> magic >> version;
+    if (magic != PP_SNAPSHOT_MAGIC || version != PP_SNAPSHOT_VERSION)
+        return false;
+    stream >> storedKey;
+    if (storedKey != key)
+        return false;
+
+    quint32 count;
+    stream >> count;
+    QList<SnapshotInput> inputs;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        SnapshotInput input;
+        stream >> input.path >> input.size >> input.modified >> input.hash;
+        inputs << input;
+    }
+
+    QStringList includePaths;
+    stream >> includePaths;
+
+    stream >> count;
+    QList<SnapshotMacro> macros;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        SnapshotMacro macro;
+        stream >> macro.name >> macro.defined >> macro.definition >> macro.formals
+               >> macro.state >> macro.lines;
+        macros << macro;
+    }
+
+    QByteArray prefixText;
+    stream >> prefixText;
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    foreach(const SnapshotInput &input, inputs) {
+        if (!snapshot_input_unchanged(input)) {
+            std::printf("Preprocessor snapshot is out of date: '%s' changed\n", qPrintable(input.path));
+            return false;
+        }
+    }
+
+    // The snapshot holds the complete macro table, including what the
+    // configuration defined, so it replaces the environment wholesale.
+    env.clear();
+    foreach(const SnapshotMacro &m, macros) {
+        rpp::pp_macro macro;
+        macro.name = to_symbol(m.name);
+        if (m.defined)
+            macro.definition = to_symbol(m.definition);
+        foreach(const QByteArray &formal, m.formals)
+            macro.formals.push_back(to_symbol(formal));
+        macro.state = m.state;
+        macro.lines = m.lines;
+        env.bind(macro.name, macro);
+    }
+
+    preprocess.include_paths.clear();
+    foreach(const QString &path, includePaths)
+        preprocess.include_paths.push_back(toStdString(path));
+
+    foreach(const SnapshotInput &input, inputs)
+        preprocess.included_files.push_back(toStdString(input.path));
+
+    text->assign(prefixText.constData(), prefixText.size());
+    return true;
+}
+
+void PreprocessHandler::saveSnapshot(const QString &fileName, const QByteArray &key, const std::string &text,
+                                     std::size_t firstIncludedFile) const {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::fprintf(stderr, "Failed to write preprocessor snapshot: %s\n", qPrintable(fileName));
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_5);
+    stream << PP_SNAPSHOT_MAGIC << PP_SNAPSHOT_VERSION << key;
+
+    QList<SnapshotInput> inputs;
+    QSet<QString> seen;
+    for (std::size_t i = firstIncludedFile; i < preprocess.included_files.size(); ++i) {
+        QFileInfo info(fromStdString(preprocess.included_files[i]));
+        QString path = info.absoluteFilePath();
+        if (seen.contains(path))
+            continue;
+        seen.insert(path);
+
+        SnapshotInput input;
+        input.path = path;
+        input.size = info.size();
+        input.modified = info.lastModified().toTime_t();
+        input.hash = file_hash(path);
+        inputs << input;
+    }
+
+    stream << quint32(inputs.size());
+    foreach(const SnapshotInput &input, inputs)
+        stream << input.path << input.size << input.modified << input.hash;
+
+    QStringList includePaths;
+    for (std::size_t i = 0; i < preprocess.include_paths.size(); ++i)
+        includePaths << fromStdString(preprocess.include_paths[i]);
+    stream << includePaths;
+
+    stream << quint32(env.last_macro() - env.first_macro());
+    for (rpp::pp_environment::const_iterator it = env.first_macro(); it != env.last_macro(); ++it) {
+        const rpp::pp_macro *macro = *it;
+        QList<QByteArray> formals;
+        for (std::size_t i = 0; i < macro->formals.size(); ++i)
+            formals << to_byte_array(macro->formals[i]);
+        stream << to_byte_array(macro->name)
+               << bool(macro->definition != 0)
+               << (macro->definition != 0 ? to_byte_array(macro->definition) : QByteArray())
+               << formals
+               << quint32(macro->state)
+               << qint32(macro->lines);
+    }
+
+    stream << QByteArray(text.c_str(), int(text.size()));
+
+    std::printf("Wrote preprocessor snapshot: '%s' (%d headers)\n", qPrintable(fileName), inputs.size());
+}
+
 QStringList PreprocessHandler::setIncludes() {
 
     QStringList includes;
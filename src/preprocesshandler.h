@@ -3,6 +3,8 @@
 #define PREPROCESSHANDLER_H_
 
 #include <QString>
+#include <QByteArray>
+#include <QFileInfo>
 
 #include "parser/rpp/pp-iterator.h"
 #include "parser/rpp/pp-engine-bits.h"
@@ -18,6 +20,9 @@ class PreprocessHandler {
 
         bool handler();
 
+        /** The master include and every header it pulled in, as absolute paths. */
+        QStringList includedFiles;
+
     private:
         rpp::pp_environment env;
         rpp::pp preprocess;
@@ -31,8 +36,21 @@ class PreprocessHandler {
         QStringList includePathList;
         QStringList inputDirectoryList;
 
+        QByteArray configText;
+
         QStringList setIncludes();
 
+        /**
+         * Preprocesses the master include, restoring the state after its first
+         * Wrapper::pp_snapshot_lines lines from Wrapper::pp_snapshot_file when
+         * the snapshot is still valid and writing a new snapshot otherwise.
+         */
+        void processWithSnapshot(const QFileInfo &sourceInfo, std::string *result);
+        QByteArray snapshotKey(const QString &sourcePath, const QByteArray &prefix) const;
+        bool loadSnapshot(const QString &fileName, const QByteArray &key, std::string *text);
+        void saveSnapshot(const QString &fileName, const QByteArray &key, const std::string &text,
+                          std::size_t firstIncludedFile) const;
+
         /**
          * Reads through master include file and writes preprocessed file for actual
          * processing of headers.
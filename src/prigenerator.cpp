@@ -72,4 +72,6 @@ void PriGenerator::generate() {
             ++m_num_generated_written;
         ++m_num_generated;
     }
+
+    m_num_generated_written -= FileOut::waitForWrites();
 }
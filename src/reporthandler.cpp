@@ -42,11 +42,15 @@ int ReportHandler::m_suppressed_count = 0;
 QString ReportHandler::m_context;
 ReportHandler::DebugLevel ReportHandler::m_debug_level = NoDebug;
 QSet<QString> ReportHandler::m_reported_warnings;
+QMutex ReportHandler::m_mutex;
 
 
 void ReportHandler::warning(const QString &text) {
     QString warningText = QString("WARNING(%1) :: %2").arg(m_context).arg(text);
 
+    // Warnings may be reported from the builder's worker threads.
+    QMutexLocker locker(&m_mutex);
+
     TypeDatabase *db = TypeDatabase::instance();
     if (db && db->isSuppressedWarning(warningText)) {
         ++m_suppressed_count;
@@ -62,6 +66,8 @@ void ReportHandler::debug(DebugLevel level, const QString &text) {
     if (m_debug_level == NoDebug)
         return;
 
-    if (level <= m_debug_level)
+    if (level <= m_debug_level) {
+        QMutexLocker locker(&m_mutex);
         qDebug(" - DEBUG(%s) :: %s", qPrintable(m_context), qPrintable(text));
+    }
 }
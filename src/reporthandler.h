@@ -38,6 +38,7 @@
 #define REPORTHANDLER_H
 
 #include <QtCore/QString>
+#include <QtCore/QMutex>
 #include <QtCore/QSet>
 
 class ReportHandler {
@@ -85,6 +86,7 @@ class ReportHandler {
         static DebugLevel m_debug_level;
         static QString m_context;
         static QSet<QString> m_reported_warnings;
+        static QMutex m_mutex;
 };
 
 #endif // REPORTHANDLER_H
@@ -0,0 +1,69 @@
+#ifndef TEXTBUFFER_H_
+#define TEXTBUFFER_H_
+
+#include <QByteArray>
+#include <QChar>
+#include <QString>
+#include <QTextStream>
+
+/**
+ * Append-only text buffer used by the generators in place of a
+ * QTextStream. It takes the same operator<< arguments and formats them
+ * the same way, but appends each one straight to a QString. There is no
+ * codec, locale lookup or write buffer on the way, and endl does not
+ * flush anything.
+ *
+ * A buffer either owns its text or appends to a string given to the
+ * constructor, like QTextStream(QString *).
+ */
+class TextBuffer {
+    public:
+        TextBuffer() : m_string(&m_own) { }
+        explicit TextBuffer(QString *string) : m_string(string) { }
+
+        const QString &string() const { return *m_string; }
+        bool isEmpty() const { return m_string->isEmpty(); }
+        void clear() { m_string->clear(); }
+        void reserve(int size) { m_string->reserve(size); }
+
+        // Kept for code written against QTextStream; nothing is buffered.
+        void flush() { }
+
+        TextBuffer &operator<<(const QString &s) { m_string->append(s); return *this; }
+        TextBuffer &operator<<(const QLatin1String &s) { m_string->append(s); return *this; }
+        TextBuffer &operator<<(const char *s) { m_string->append(QLatin1String(s)); return *this; }
+        TextBuffer &operator<<(const QByteArray &s) { m_string->append(QString::fromAscii(s.constData(), s.size())); return *this; }
+        TextBuffer &operator<<(QChar c) { m_string->append(c); return *this; }
+        TextBuffer &operator<<(char c) { m_string->append(QChar::fromAscii(c)); return *this; }
+
+        TextBuffer &operator<<(short n) { m_string->append(QString::number(n)); return *this; }
+        TextBuffer &operator<<(unsigned short n) { m_string->append(QString::number(n)); return *this; }
+        TextBuffer &operator<<(int n) { m_string->append(QString::number(n)); return *this; }
+        TextBuffer &operator<<(unsigned int n) { m_string->append(QString::number(n)); return *this; }
+        TextBuffer &operator<<(long n) { m_string->append(QString::number(n)); return *this; }
+        TextBuffer &operator<<(unsigned long n) { m_string->append(QString::number(n)); return *this; }
+        TextBuffer &operator<<(qlonglong n) { m_string->append(QString::number(n)); return *this; }
+        TextBuffer &operator<<(qulonglong n) { m_string->append(QString::number(n)); return *this; }
+        // QTextStream's default real number notation.
+        TextBuffer &operator<<(double d) { m_string->append(QString::number(d, 'g', 6)); return *this; }
+
+        /**
+         * Accepts the QTextStream manipulators the generators use: endl
+         * appends a newline, flush does nothing.
+         */
+        TextBuffer &operator<<(QTextStreamFunction f) {
+            if (f == static_cast<QTextStreamFunction>(::endl))
+                m_string->append(QLatin1Char('\n'));
+            else
+                Q_ASSERT(f == static_cast<QTextStreamFunction>(::flush));
+            return *this;
+        }
+
+    private:
+        Q_DISABLE_COPY(TextBuffer)
+
+        QString m_own;
+        QString *m_string;
+};
+
+#endif // TEXTBUFFER_H_
@@ -15,3 +15,34 @@ QString CodeSnipFragment::code() const {
     else
         return m_code;
 }
+
+QStringList CodeSnipFragment::lines() const {
+    if (!m_lines_valid) {
+        m_lines = code().split("\n");
+        m_lines_valid = true;
+    }
+    return m_lines;
+}
+
+/*!
+ * Returns the same lines as code().split("\n"), joined from the cached
+ * lines of each fragment.
+ */
+QStringList CodeSnipAbstract::lines() const {
+    if (codeList.size() == 1)
+        return codeList.first()->lines();
+
+    QStringList res;
+    foreach(CodeSnipFragment *codeFrag, codeList) {
+        QStringList fragLines = codeFrag->lines();
+        if (res.isEmpty()) {
+            res = fragLines;
+        } else {
+            res.last() += fragLines.first();
+            res += fragLines.mid(1);
+        }
+    }
+    if (res.isEmpty())
+        res << QString();
+    return res;
+}
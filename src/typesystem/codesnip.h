@@ -3,10 +3,11 @@
 #define CODESNIP_H_
 
 #include <QMap>
-#include <QTextStream>
+#include <QStringList>
 #include "typesystem.h"
 
 class Indentor;
+class TextBuffer;
 typedef QMap<int, QString> ArgumentMap;
 
 class CodeSnipFragment {
@@ -14,20 +15,28 @@ class CodeSnipFragment {
         const QString m_code;
         TemplateInstance *m_instance;
 
+        // code() split on newlines, computed on first use
+        mutable QStringList m_lines;
+        mutable bool m_lines_valid;
+
     public:
         CodeSnipFragment(const QString &code)
                 : m_code(code),
-                m_instance(0) {}
+                m_instance(0),
+                m_lines_valid(false) {}
 
         CodeSnipFragment(TemplateInstance *instance)
-                : m_instance(instance) {}
+                : m_instance(instance),
+                m_lines_valid(false) {}
 
         QString code() const;
+        QStringList lines() const;
 };
 
 class CodeSnipAbstract {
     public:
         QString code() const;
+        QStringList lines() const;
 
         void addCode(const QString &code) {
             codeList.append(new CodeSnipFragment(code));
@@ -74,7 +83,7 @@ class CodeSnip : public CodeSnipAbstract {
         CodeSnip(TypeSystem::Language lang) : language(lang) { }
 
         // Very simple, easy to make code ugly if you try
-        QTextStream &formattedCode(QTextStream &s, Indentor &indentor) const;
+        TextBuffer &formattedCode(TextBuffer &s, Indentor &indentor) const;
 
         TypeSystem::Language language;
         Position position;
@@ -5,51 +5,32 @@
 
 #include "handler.h"
 #include "typedatabase.h"
+#include "typesystemloader.h"
 #include "wrapper.h"			/* for isTargetPlatformArmCpu */
 #include "../reporthandler.h"
 #include "../main.h"
 
-bool Handler::error(const QXmlParseException &e) {
-    qWarning("Error: line=%d, column=%d, message=%s\n",
-             e.lineNumber(), e.columnNumber(), qPrintable(e.message()));
-    return false;
-}
-
-bool Handler::fatalError(const QXmlParseException &e) {
-    qWarning("Fatal error: line=%d, column=%d, message=%s\n",
-             e.lineNumber(), e.columnNumber(), qPrintable(e.message()));
-
-    return false;
-}
-
-bool Handler::warning(const QXmlParseException &e) {
-    qWarning("Warning: line=%d, column=%d, message=%s\n",
-             e.lineNumber(), e.columnNumber(), qPrintable(e.message()));
-
-    return false;
-}
-
-void Handler::fetchAttributeValues(const QString &name, const QXmlAttributes &atts,
-                                   QHash<QString, QString> *acceptedAttributes) {
+void Handler::fetchAttributeValues(const TypesystemEvent &event, AttributeValues *acceptedAttributes) {
     Q_ASSERT(acceptedAttributes != 0);
 
-    for (int i = 0; i < atts.length(); ++i) {
-        QString key = atts.localName(i).toLower();
-        const QString val = atts.value(i);
+    for (int i = 0; i < event.attributes.size(); ++i) {
+        const QXmlStreamAttribute &att = event.attributes.at(i);
+        Attribute::Id id = event.attributeIds.at(i);
 
-        if (!acceptedAttributes->contains(key)) {
-            const QString qname = atts.qName(i);
+        if (!acceptedAttributes->contains(id)) {
+            const QString qname = att.qualifiedName().toString();
             if (qname.indexOf(':') < 0)	// FIXME remove this once namespace work is done
-                ReportHandler::warning(QString("Unknown attribute for '%1': '%2'").arg(name).arg(key));
+                ReportHandler::warning(QString("Unknown attribute for '%1': '%2'")
+                                       .arg(event.name).arg(att.name().toString().toLower()));
         } else {
-            (*acceptedAttributes)[key] = val;
+            (*acceptedAttributes)[id] = att.value().toString();
         }
     }
 }
 
-bool Handler::endElement(const QString &, const QString &localName, const QString &) {
-    QString tagName = localName.toLower();
-    if (tagName == "import-file")
+bool Handler::endElement(const TypesystemEvent &event) {
+    // Unknown tags fail in startElement(), so this is <import-file>.
+    if (event.elementType == StackElement::None)
         return true;
 
     if (!current)
@@ -112,6 +93,9 @@ bool Handler::endElement(const QString &, const QString &localName, const QStrin
 }
 
 bool Handler::characters(const QString &ch) {
+    if (!current)
+        return true;
+
     if (current->type == StackElement::Template) {
         current->value.templateEntry->addCode(ch);
         return true;
@@ -152,60 +136,42 @@ bool Handler::characters(const QString &ch) {
     return true;
 }
 
-bool Handler::importFileElement(const QXmlAttributes &atts) {
-    QString fileName = atts.value("name");
+bool Handler::importFileElement(const QXmlStreamAttributes &atts) {
+    QString fileName = atts.value("name").toString();
     if (fileName.isEmpty()) {
         m_error = "Required attribute 'name' missing for include-file tag.";
         return false;
     }
 
-    QFile file(fileName);
-    QFileInfo fileinfo(file);
-    if (fileinfo.isRelative() && !m_importInputDirectoryList.isEmpty()) {
+    QString filepath = fileName;
+    if (QFileInfo(fileName).isRelative() && !m_importInputDirectoryList.isEmpty()) {
         // Resolve
-        QString filepath = resolveFilePath(fileName, 0, m_importInputDirectoryList);
+        filepath = resolveFilePath(fileName, 0, m_importInputDirectoryList);
         if(filepath.isNull()) {
             m_error = QString("Could not open file: '%1'").arg(fileName);
             return false;
         }
-        file.setFileName(filepath);
     }
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-#if 0
-        // This feature is disabled, better to use actual files
-        file.setFileName(":/trolltech/generator/" + fileName);
-        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-#endif
-            m_error = QString("Could not open file: '%1'").arg(fileName);
-            return false;
-#if 0
-        }
-#endif
+
+    // The same files are quoted many times with different markers, so
+    // they are read and indexed once per typesystem load.
+    Q_ASSERT(m_loader != 0);
+    ImportedFile *file = m_loader->importedFile(filepath);
+    if (!file) {
+        m_error = QString("Could not open file: '%1'").arg(fileName);
+        return false;
     }
 
-    QString quoteFrom = atts.value("quote-after-line");
-    bool foundFromOk = quoteFrom.isEmpty();
-    bool from = quoteFrom.isEmpty();
+    QString quoteFrom = atts.value("quote-after-line").toString();
+    bool foundFromOk;
 
-    QString quoteTo = atts.value("quote-before-line");
-    bool foundToOk = quoteTo.isEmpty();
-    bool to = true;
+    QString quoteTo = atts.value("quote-before-line").toString();
+    bool foundToOk;
+
+    QString code = file->snippet(quoteFrom, quoteTo, &foundFromOk, &foundToOk);
+    if (!code.isEmpty())
+        characters(code);
 
-    QTextStream in(&file);
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        if (from && to && line.contains(quoteTo)) {
-            to = false;
-            foundToOk = true;
-            break;
-        }
-        if (from && to)
-            characters(line + "\n");
-        if (!from && line.contains(quoteFrom)) {
-            from = true;
-            foundFromOk = true;
-        }
-    }
     if (!foundFromOk || !foundToOk) {
         QString fromError = QString("Could not find quote-after-line='%1' in file '%2'.").arg(quoteFrom).arg(fileName);
         QString toError = QString("Could not find quote-before-line='%1' in file '%2'.").arg(quoteTo).arg(fileName);
@@ -237,46 +203,49 @@ bool Handler::convertBoolean(const QString &_value, const QString &attributeName
     }
 }
 
-QHash<QString, QString> Handler::setStackElementAttributes(StackElement::ElementType type) {
-    QHash<QString, QString> attributes;
-    attributes["name"] = QString();
+AttributeValues Handler::setStackElementAttributes(StackElement::ElementType type) {
+    AttributeValues attributes;
+    attributes[Attribute::Name] = QString();
 
     switch (type) {
         case StackElement::PrimitiveTypeEntry:
-            attributes["java-name"] = QString();
-            attributes["jni-name"] = QString();
-            attributes["preferred-conversion"] = "yes";
-            attributes["preferred-java-type"] = "yes";
+            attributes[Attribute::JavaName] = QString();
+            attributes[Attribute::JniName] = QString();
+            attributes[Attribute::PreferredConversion] = "yes";
+            attributes[Attribute::PreferredJavaType] = "yes";
+            attributes[Attribute::BulkContainers] = "no";
             break;
         case StackElement::EnumTypeEntry:
-            attributes["flags"] = "no";
-            attributes["upper-bound"] = QString();
-            attributes["lower-bound"] = QString();
-            attributes["force-integer"] = "no";
-            attributes["extensible"] = "no";
+            attributes[Attribute::Flags] = "no";
+            attributes[Attribute::UpperBound] = QString();
+            attributes[Attribute::LowerBound] = QString();
+            attributes[Attribute::ForceInteger] = "no";
+            attributes[Attribute::Extensible] = "no";
 
             break;
 
         case StackElement::ObjectTypeEntry:
         case StackElement::ValueTypeEntry:
-            attributes["force-abstract"] = QString("no");
-            attributes["deprecated"] = QString("no");
-            attributes["implements"] = QString();
+            attributes[Attribute::ForceAbstract] = QString("no");
+            attributes[Attribute::Deprecated] = QString("no");
+            attributes[Attribute::Implements] = QString();
+            if (type == StackElement::ValueTypeEntry)
+                attributes[Attribute::Flatten] = QString();
             // fall throooough
         case StackElement::InterfaceTypeEntry:
-            attributes["default-superclass"] = m_defaultSuperclass;
-            attributes["polymorphic-id-expression"] = QString();
-            attributes["delete-in-main-thread"] = QString("no");
+            attributes[Attribute::DefaultSuperclass] = m_defaultSuperclass;
+            attributes[Attribute::PolymorphicIdExpression] = QString();
+            attributes[Attribute::DeleteInMainThread] = QString("no");
             // fall through
         case StackElement::NamespaceTypeEntry:
-            attributes["java-name"] = QString();
-            attributes["package"] = m_defaultPackage;
-            attributes["expense-cost"] = "1";
-            attributes["expense-limit"] = "none";
-            attributes["polymorphic-base"] = QString("no");
-            attributes["generate"] = QString("yes");
-            attributes["target-type"] = QString();
-            attributes["generic-class"] = QString("no");
+            attributes[Attribute::JavaName] = QString();
+            attributes[Attribute::Package] = m_defaultPackage;
+            attributes[Attribute::ExpenseCost] = "1";
+            attributes[Attribute::ExpenseLimit] = "none";
+            attributes[Attribute::PolymorphicBase] = QString("no");
+            attributes[Attribute::Generate] = QString("yes");
+            attributes[Attribute::TargetType] = QString();
+            attributes[Attribute::GenericClass] = QString("no");
             break;
         default:
             ; // nada
@@ -285,33 +254,28 @@ QHash<QString, QString> Handler::setStackElementAttributes(StackElement::Element
     return attributes;
 }
 
-bool Handler::startElement(const QString &, const QString &n,
-                           const QString &, const QXmlAttributes &atts) {
-    QString tagName = n.toLower();
-    if (tagName == "import-file") {
-        return importFileElement(atts);
-    }
+bool Handler::startElement(const TypesystemEvent &event) {
+    const QString &tagName = event.name;
+    if (event.elementType == StackElement::None) {
+        if (tagName == "import-file")
+            return importFileElement(event.attributes);
 
-    StackElement *element = new StackElement(current);
-
-    if (!tagNames.contains(tagName)) {
         m_error = QString("Unknown tag name: '%1'").arg(tagName);
         return false;
     }
 
-    element->type = tagNames[tagName];
+    StackElement *element = new StackElement(current);
+    element->type = event.elementType;
     if (element->type & StackElement::TypeEntryMask) {
         if (current->type != StackElement::Root) {
             m_error = "Nested types not supported";
             return false;
         }
 
-        QHash<QString, QString> attributes;
+        AttributeValues attributes = setStackElementAttributes(element->type);
+        fetchAttributeValues(event, &attributes);
 
-        attributes = setStackElementAttributes(element->type);
-        fetchAttributeValues(tagName, atts, &attributes);
-
-        QString name = attributes["name"];
+        QString name = attributes[Attribute::Name];
 
         /*
         We need to be able to have duplicate primitive type entries, or it's not possible to
@@ -331,10 +295,11 @@ bool Handler::startElement(const QString &, const QString &n,
         }
         switch (element->type) {
             case StackElement::PrimitiveTypeEntry: {
-                QString java_name = attributes["java-name"];
-                QString jni_name = attributes["jni-name"];
-                QString preferred_conversion = attributes["preferred-conversion"].toLower();
-                QString preferred_java_type = attributes["preferred-java-type"].toLower();
+                QString java_name = attributes[Attribute::JavaName];
+                QString jni_name = attributes[Attribute::JniName];
+                QString preferred_conversion = attributes[Attribute::PreferredConversion].toLower();
+                QString preferred_java_type = attributes[Attribute::PreferredJavaType].toLower();
+                QString bulk_containers = attributes[Attribute::BulkContainers].toLower();
 
                 if (java_name.isEmpty())
                     java_name = name;
@@ -348,6 +313,19 @@ bool Handler::startElement(const QString &, const QString &n,
 
                 type->setPreferredConversion(convertBoolean(preferred_conversion, "preferred-conversion", true));
                 type->setPreferredTargetLangType(convertBoolean(preferred_java_type, "preferred-java-type", true));
+                type->setBulkContainers(convertBoolean(bulk_containers, "bulk-containers", false));
+
+                if (type->bulkContainers()) {
+                    static QStringList array_types = QStringList()
+                        << "jboolean" << "jbyte" << "jchar" << "jshort"
+                        << "jint" << "jlong" << "jfloat" << "jdouble";
+                    if (!array_types.contains(jni_name)) {
+                        m_error = QString("bulk-containers requires a primitive jni-name, got '%1' for '%2'")
+                                  .arg(jni_name).arg(name);
+                        delete type;
+                        return false;
+                    }
+                }
 
                 element->entry = type;
             }
@@ -366,16 +344,16 @@ bool Handler::startElement(const QString &, const QString &n,
                 element->entry = eentry;
                 eentry->setCodeGeneration(m_generate);
                 eentry->setTargetLangPackage(m_defaultPackage);
-                eentry->setUpperBound(attributes["upper-bound"]);
-                eentry->setLowerBound(attributes["lower-bound"]);
-                eentry->setForceInteger(convertBoolean(attributes["force-integer"], "force-integer", false));
-                eentry->setExtensible(convertBoolean(attributes["extensible"], "extensible", false));
+                eentry->setUpperBound(attributes[Attribute::UpperBound]);
+                eentry->setLowerBound(attributes[Attribute::LowerBound]);
+                eentry->setForceInteger(convertBoolean(attributes[Attribute::ForceInteger], "force-integer", false));
+                eentry->setExtensible(convertBoolean(attributes[Attribute::Extensible], "extensible", false));
 
                 // put in the flags parallel...
-                if (!attributes["flags"].isEmpty() && attributes["flags"].toLower() != "no") {
+                if (!attributes[Attribute::Flags].isEmpty() && attributes[Attribute::Flags].toLower() != "no") {
                     FlagsTypeEntry *ftype = new FlagsTypeEntry("QFlags<" + name + ">");
                     ftype->setOriginator(eentry);
-                    ftype->setOriginalName(attributes["flags"]);
+                    ftype->setOriginalName(attributes[Attribute::Flags]);
                     ftype->setCodeGeneration(m_generate);
                     QString n = ftype->originalName();
 
@@ -399,13 +377,13 @@ bool Handler::startElement(const QString &, const QString &n,
 
             case StackElement::InterfaceTypeEntry: {
                 ObjectTypeEntry *otype = new ObjectTypeEntry(name);
-                QString javaName = attributes["java-name"];
+                QString javaName = attributes[Attribute::JavaName];
                 if (javaName.isEmpty())
                     javaName = name;
                 InterfaceTypeEntry *itype =
                     new InterfaceTypeEntry(InterfaceTypeEntry::interfaceName(javaName));
 
-                if (!convertBoolean(attributes["generate"], "generate", true))
+                if (!convertBoolean(attributes[Attribute::Generate], "generate", true))
                     itype->setCodeGeneration(TypeEntry::GenerateForSubclass);
                 else
                     itype->setCodeGeneration(m_generate);
@@ -430,56 +408,63 @@ bool Handler::startElement(const QString &, const QString &n,
                 }
 
                 ComplexTypeEntry *ctype = static_cast<ComplexTypeEntry *>(element->entry);
-                ctype->setTargetLangPackage(attributes["package"]);
-                ctype->setDefaultSuperclass(attributes["default-superclass"]);
-                ctype->setGenericClass(convertBoolean(attributes["generic-class"], "generic-class", false));
-                ctype->setImplements(attributes["implements"]);
+                ctype->setTargetLangPackage(attributes[Attribute::Package]);
+                ctype->setDefaultSuperclass(attributes[Attribute::DefaultSuperclass]);
+                ctype->setGenericClass(convertBoolean(attributes[Attribute::GenericClass], "generic-class", false));
+                ctype->setImplements(attributes[Attribute::Implements]);
 
-                if (!convertBoolean(attributes["generate"], "generate", true))
+                if (!convertBoolean(attributes[Attribute::Generate], "generate", true))
                     element->entry->setCodeGeneration(TypeEntry::GenerateForSubclass);
                 else
                     element->entry->setCodeGeneration(m_generate);
 
-                QString javaName = attributes["java-name"];
+                QString javaName = attributes[Attribute::JavaName];
                 if (!javaName.isEmpty())
                     ctype->setTargetLangName(javaName);
 
                 // The expense policy
-                QString limit = attributes["expense-limit"];
+                QString limit = attributes[Attribute::ExpenseLimit];
                 if (!limit.isEmpty() && limit != "none") {
                     ExpensePolicy ep;
                     ep.limit = limit.toInt();
-                    ep.cost = attributes["expense-cost"];
+                    ep.cost = attributes[Attribute::ExpenseCost];
                     ctype->setExpensePolicy(ep);
                 }
 
-                ctype->setIsPolymorphicBase(convertBoolean(attributes["polymorphic-base"], "polymorphic-base", false));
-                ctype->setPolymorphicIdValue(attributes["polymorphic-id-expression"]);
+                ctype->setIsPolymorphicBase(convertBoolean(attributes[Attribute::PolymorphicBase], "polymorphic-base", false));
+                ctype->setPolymorphicIdValue(attributes[Attribute::PolymorphicIdExpression]);
 
                 if (element->type == StackElement::ObjectTypeEntry ||
                         element->type == StackElement::ValueTypeEntry ||
                         element->type == StackElement::InterfaceTypeEntry) {
 
                     if (element->type != StackElement::InterfaceTypeEntry) { // ObjectTypeEntry or ValueTypeEntry
-                        if (convertBoolean(attributes["force-abstract"], "force-abstract", false))
+                        if (convertBoolean(attributes[Attribute::ForceAbstract], "force-abstract", false))
                             ctype->setTypeFlags(ctype->typeFlags() | ComplexTypeEntry::ForceAbstract);
 
-                        if (convertBoolean(attributes["deprecated"], "deprecated", false))
+                        if (convertBoolean(attributes[Attribute::Deprecated], "deprecated", false))
                             ctype->setTypeFlags(ctype->typeFlags() | ComplexTypeEntry::Deprecated);
                     }
 
-                    if (convertBoolean(attributes["delete-in-main-thread"], "delete-in-main-thread", false))
+                    if (element->type == StackElement::ValueTypeEntry && !attributes[Attribute::Flatten].isEmpty()) {
+                        QStringList fields;
+                        foreach(QString field, attributes[Attribute::Flatten].split(",", QString::SkipEmptyParts))
+                            fields << field.trimmed();
+                        static_cast<ValueTypeEntry *>(element->entry)->setFlattenedFields(fields);
+                    }
+
+                    if (convertBoolean(attributes[Attribute::DeleteInMainThread], "delete-in-main-thread", false))
                         ctype->setTypeFlags(ctype->typeFlags() | ComplexTypeEntry::DeleteInMainThread);
                 }
 
-                QString targetType = attributes["target-type"];
+                QString targetType = attributes[Attribute::TargetType];
                 if (!targetType.isEmpty())
                     ctype->setTargetType(targetType);
 
                 // ctype->setInclude(Include(Include::IncludePath, ctype->name()));
                 ctype = ctype->designatedInterface();
                 if (ctype != 0)
-                    ctype->setTargetLangPackage(attributes["package"]);
+                    ctype->setTargetLangPackage(attributes[Attribute::Package]);
 
             }
             break;
@@ -510,124 +495,125 @@ bool Handler::startElement(const QString &, const QString &n,
         StackElement topElement = current == 0 ? StackElement(0) : *current;
         element->entry = topElement.entry;
 
-        QHash<QString, QString> attributes;
+        AttributeValues attributes;
         switch (element->type) {
             case StackElement::Root:
-                attributes["package"] = QString();
-                attributes["default-superclass"] = QString();
+                attributes[Attribute::Package] = QString();
+                attributes[Attribute::DefaultSuperclass] = QString();
                 break;
             case StackElement::LoadTypesystem:
-                attributes["name"] = QString();
-                attributes["generate"] = "yes";
-                attributes["optional"] = "no";
+                attributes[Attribute::Name] = QString();
+                attributes[Attribute::Generate] = "yes";
+                attributes[Attribute::Optional] = "no";
                 break;
             case StackElement::NoNullPointers:
-                attributes["default-value"] = QString();
+                attributes[Attribute::DefaultValue] = QString();
                 break;
             case StackElement::SuppressedWarning:
-                attributes["text"] = QString();
+                attributes[Attribute::Text] = QString();
                 break;
             case StackElement::ReplaceDefaultExpression:
-                attributes["with"] = QString();
+                attributes[Attribute::With] = QString();
                 break;
             case StackElement::DefineOwnership:
-                attributes["class"] = "java";
-                attributes["owner"] = "";
+                attributes[Attribute::Class] = "java";
+                attributes[Attribute::Owner] = "";
                 break;
             case StackElement::ModifyFunction:
-                attributes["signature"] = QString();
-                attributes["access"] = QString();
-                attributes["remove"] = QString();
-                attributes["rename"] = QString();
-                attributes["deprecated"] = QString("no");
-                attributes["associated-to"] = QString();
-                attributes["virtual-slot"] = QString("no");
-                attributes["allow-as-slot"] = QString("no");
-                attributes["private-signal"] = QString("no");
+                attributes[Attribute::Signature] = QString();
+                attributes[Attribute::Access] = QString();
+                attributes[Attribute::Remove] = QString();
+                attributes[Attribute::Rename] = QString();
+                attributes[Attribute::Deprecated] = QString("no");
+                attributes[Attribute::AssociatedTo] = QString();
+                attributes[Attribute::VirtualSlot] = QString("no");
+                attributes[Attribute::AllowAsSlot] = QString("no");
+                attributes[Attribute::PrivateSignal] = QString("no");
                 break;
             case StackElement::ModifyArgument:
-                attributes["index"] = QString();
-                attributes["replace-value"] = QString();
-                attributes["invalidate-after-use"] = QString("no");
+                attributes[Attribute::Index] = QString();
+                attributes[Attribute::ReplaceValue] = QString();
+                attributes[Attribute::InvalidateAfterUse] = QString("no");
+                attributes[Attribute::StringConversion] = QString("default");
                 break;
             case StackElement::ModifyField:
-                attributes["name"] = QString();
-                attributes["write"] = "true";
-                attributes["read"] = "true";
+                attributes[Attribute::Name] = QString();
+                attributes[Attribute::Write] = "true";
+                attributes[Attribute::Read] = "true";
                 break;
             case StackElement::Access:
-                attributes["modifier"] = QString();
+                attributes[Attribute::Modifier] = QString();
                 break;
             case StackElement::Include:
-                attributes["file-name"] = QString();
-                attributes["location"] = QString();
+                attributes[Attribute::FileName] = QString();
+                attributes[Attribute::Location] = QString();
                 break;
             case StackElement::CustomMetaConstructor:
-                attributes["name"] = topElement.entry->name().toLower() + "_create";
-                attributes["param-name"] = "copy";
+                attributes[Attribute::Name] = topElement.entry->name().toLower() + "_create";
+                attributes[Attribute::ParamName] = "copy";
                 break;
             case StackElement::CustomMetaDestructor:
-                attributes["name"] = topElement.entry->name().toLower() + "_delete";
-                attributes["param-name"] = "copy";
+                attributes[Attribute::Name] = topElement.entry->name().toLower() + "_delete";
+                attributes[Attribute::ParamName] = "copy";
                 break;
             case StackElement::ReplaceType:
-                attributes["modified-type"] = QString();
+                attributes[Attribute::ModifiedType] = QString();
                 break;
             case StackElement::InjectCode:
-                attributes["class"] = "java";
-                attributes["position"] = "beginning";
+                attributes[Attribute::Class] = "java";
+                attributes[Attribute::Position] = "beginning";
                 break;
             case StackElement::ConversionRule:
-                attributes["class"] = "";
+                attributes[Attribute::Class] = "";
                 break;
             case StackElement::RejectEnumValue:
-                attributes["name"] = "";
+                attributes[Attribute::Name] = "";
                 break;
             case StackElement::ArgumentMap:
-                attributes["index"] = "1";
-                attributes["meta-name"] = QString();
+                attributes[Attribute::Index] = "1";
+                attributes[Attribute::MetaName] = QString();
                 break;
             case StackElement::Rename:
-                attributes["to"] = QString();
+                attributes[Attribute::To] = QString();
                 break;
             case StackElement::Rejection:
-                attributes["class"] = "*";
-                attributes["function-name"] = "*";
-                attributes["field-name"] = "*";
-                attributes["enum-name"] = "*";
+                attributes[Attribute::Class] = "*";
+                attributes[Attribute::FunctionName] = "*";
+                attributes[Attribute::FieldName] = "*";
+                attributes[Attribute::EnumName] = "*";
                 break;
             case StackElement::Removal:
-                attributes["class"] = "all";
+                attributes[Attribute::Class] = "all";
                 break;
             case StackElement::Template:
-                attributes["name"] = QString();
+                attributes[Attribute::Name] = QString();
                 break;
             case StackElement::TemplateInstanceEnum:
-                attributes["name"] = QString();
+                attributes[Attribute::Name] = QString();
                 break;
             case StackElement::Replace:
-                attributes["from"] = QString();
-                attributes["to"] = QString();
+                attributes[Attribute::From] = QString();
+                attributes[Attribute::To] = QString();
                 break;
             case StackElement::ReferenceCount:
-                attributes["action"] = QString();
-                attributes["variable-name"] = QString();
-                attributes["thread-safe"] = QString("no");
-                attributes["declare-variable"] = QString();
-                attributes["access"] = QString("private");
-                attributes["conditional"] = QString("");
+                attributes[Attribute::Action] = QString();
+                attributes[Attribute::VariableName] = QString();
+                attributes[Attribute::ThreadSafe] = QString("no");
+                attributes[Attribute::DeclareVariable] = QString();
+                attributes[Attribute::Access] = QString("private");
+                attributes[Attribute::Conditional] = QString("");
                 break;
             default:
                 ; // nada
         };
 
         if (attributes.count() > 0)
-            fetchAttributeValues(tagName, atts, &attributes);
+            fetchAttributeValues(event, &attributes);
 
         switch (element->type) {
             case StackElement::Root:
-                m_defaultPackage = attributes["package"];
-                m_defaultSuperclass = attributes["default-superclass"];
+                m_defaultPackage = attributes[Attribute::Package];
+                m_defaultSuperclass = attributes[Attribute::DefaultSuperclass];
                 element->type = StackElement::Root;
                 element->entry = new TypeSystemTypeEntry(m_defaultPackage);
                 //qDebug()<<"Adding element->entry (root)"<<element->entry->name();
@@ -635,13 +621,13 @@ bool Handler::startElement(const QString &, const QString &n,
                 TypeDatabase::instance()->addType(element->entry);
                 break;
             case StackElement::LoadTypesystem: {
-                QString name = attributes["name"];
+                QString name = attributes[Attribute::Name];
                 if (name.isEmpty()) {
                     m_error = "No typesystem name specified";
                     return false;
                 }
 
-                if (!m_database->parseFile(name, m_importInputDirectoryList, convertBoolean(attributes["generate"], "generate", true), convertBoolean(attributes["optional"], "optional", false))) {
+                if (!m_database->parseFile(name, m_importInputDirectoryList, convertBoolean(attributes[Attribute::Generate], "generate", true), convertBoolean(attributes[Attribute::Optional], "optional", false))) {
                     m_error = QString("Failed to parse: '%1'").arg(name);
                     return false;
                 }
@@ -652,7 +638,7 @@ bool Handler::startElement(const QString &, const QString &n,
                     m_error = "<reject-enum-value> node must be used inside a <enum-type> node";
                     return false;
                 }
-                QString name = attributes["name"];
+                QString name = attributes[Attribute::Name];
 
                 if (!name.isEmpty()) {
                     EnumTypeEntry *eentry = static_cast<EnumTypeEntry*>(current->entry);
@@ -667,12 +653,12 @@ bool Handler::startElement(const QString &, const QString &n,
                     return false;
                 }
 
-                if (attributes["modified-type"].isEmpty()) {
+                if (attributes[Attribute::ModifiedType].isEmpty()) {
                     m_error = "Type replacement requires 'modified-type' attribute";
                     return false;
                 }
 
-                m_function_mods.last().argument_mods.last().modified_type = attributes["modified-type"];
+                m_function_mods.last().argument_mods.last().modified_type = attributes[Attribute::ModifiedType];
             }
             break;
             case StackElement::ConversionRule: {
@@ -688,7 +674,7 @@ bool Handler::startElement(const QString &, const QString &n,
                 }
 
                 CodeSnip snip;
-                QString languageAttribute = attributes["class"].toLower();
+                QString languageAttribute = attributes[Attribute::Class].toLower();
                 TypeSystem::Language lang = languageNames.value(languageAttribute, TypeSystem::NoLanguage);
                 if (lang == TypeSystem::NoLanguage) {
                     m_error = QString("unsupported class attribute: '%1'").arg(languageAttribute);
@@ -708,7 +694,7 @@ bool Handler::startElement(const QString &, const QString &n,
                     return false;
                 }
 
-                QString index = attributes["index"];
+                QString index = attributes[Attribute::Index];
                 if (index == "return")
                     index = "0";
                 else if (index == "this")
@@ -721,7 +707,7 @@ bool Handler::startElement(const QString &, const QString &n,
                     return false;
                 }
 
-                QString replace_value = attributes["replace-value"];
+                QString replace_value = attributes[Attribute::ReplaceValue];
 
                 if (!replace_value.isEmpty() && idx != 0) {
                     m_error = QString("replace-value is only supported for return values (index=0).");
@@ -730,7 +716,21 @@ bool Handler::startElement(const QString &, const QString &n,
 
                 ArgumentModification argumentModification = ArgumentModification(idx);
                 argumentModification.replace_value = replace_value;
-                argumentModification.reset_after_use = convertBoolean(attributes["invalidate-after-use"], "invalidate-after-use", false);
+                argumentModification.reset_after_use = convertBoolean(attributes[Attribute::InvalidateAfterUse], "invalidate-after-use", false);
+
+                static QHash<QString, TypeSystem::StringConversion> stringConversions;
+                if (stringConversions.isEmpty()) {
+                    stringConversions["default"] = TypeSystem::DefaultStringConversion;
+                    stringConversions["direct"] = TypeSystem::DirectStringConversion;
+                    stringConversions["ascii"] = TypeSystem::AsciiStringConversion;
+                }
+
+                QString string_conversion = attributes[Attribute::StringConversion].toLower();
+                if (!stringConversions.contains(string_conversion)) {
+                    m_error = QString("unsupported string-conversion attribute: '%1'").arg(string_conversion);
+                    return false;
+                }
+                argumentModification.string_conversion = stringConversions.value(string_conversion);
                 m_function_mods.last().argument_mods.append(argumentModification);
             }
             break;
@@ -742,8 +742,8 @@ bool Handler::startElement(const QString &, const QString &n,
 
                 m_function_mods.last().argument_mods.last().no_null_pointers = true;
                 if (m_function_mods.last().argument_mods.last().index == 0) {
-                    m_function_mods.last().argument_mods.last().null_pointer_default_value = attributes["default-value"];
-                } else if (!attributes["default-value"].isEmpty()) {
+                    m_function_mods.last().argument_mods.last().null_pointer_default_value = attributes[Attribute::DefaultValue];
+                } else if (!attributes[Attribute::DefaultValue].isEmpty()) {
                     ReportHandler::warning("default values for null pointer guards are only effective for return values");
                 }
             }
@@ -760,7 +760,7 @@ bool Handler::startElement(const QString &, const QString &n,
                     languageNames["shell"] = TypeSystem::ShellCode;
                 }
 
-                QString classAttribute = attributes["class"].toLower();
+                QString classAttribute = attributes[Attribute::Class].toLower();
                 TypeSystem::Language lang = languageNames.value(classAttribute, TypeSystem::NoLanguage);
                 if (lang == TypeSystem::NoLanguage) {
                     m_error = QString("unsupported class attribute: '%1'").arg(classAttribute);
@@ -776,7 +776,7 @@ bool Handler::startElement(const QString &, const QString &n,
                     ownershipNames["default"] = TypeSystem::DefaultOwnership;
                 }
 
-                QString ownershipAttribute = attributes["owner"].toLower();
+                QString ownershipAttribute = attributes[Attribute::Owner].toLower();
                 TypeSystem::Ownership owner = ownershipNames.value(ownershipAttribute, TypeSystem::InvalidOwnership);
                 if (owner == TypeSystem::InvalidOwnership) {
                     m_error = QString("unsupported owner attribute: '%1'").arg(ownershipAttribute);
@@ -787,10 +787,10 @@ bool Handler::startElement(const QString &, const QString &n,
             }
             break;
             case StackElement::SuppressedWarning:
-                if (attributes["text"].isEmpty())
+                if (attributes[Attribute::Text].isEmpty())
                     ReportHandler::warning("Suppressed warning with no text specified");
                 else
-                    m_database->addSuppressedWarning(attributes["text"]);
+                    m_database->addSuppressedWarning(attributes[Attribute::Text]);
                 break;
             case StackElement::ArgumentMap: {
                 if (!(topElement.type & StackElement::CodeSnipMask)) {
@@ -799,10 +799,10 @@ bool Handler::startElement(const QString &, const QString &n,
                 }
 
                 bool ok;
-                int pos = attributes["index"].toInt(&ok);
+                int pos = attributes[Attribute::Index].toInt(&ok);
                 if (!ok) {
                     m_error = QString("Can't convert attribute index '%1' to integer")
-                              .arg(attributes["index"]);
+                              .arg(attributes[Attribute::Index]);
                     return false;
                 }
 
@@ -811,7 +811,7 @@ bool Handler::startElement(const QString &, const QString &n,
                     return false;
                 }
 
-                QString meta_name = attributes["meta-name"];
+                QString meta_name = attributes[Attribute::MetaName];
                 if (meta_name.isEmpty()) {
                     ReportHandler::warning("Empty meta name in argument map");
                 }
@@ -836,7 +836,7 @@ bool Handler::startElement(const QString &, const QString &n,
                     languageNames["all"] = TypeSystem::All;
                 }
 
-                QString languageAttribute = attributes["class"].toLower();
+                QString languageAttribute = attributes[Attribute::Class].toLower();
                 TypeSystem::Language lang = languageNames.value(languageAttribute, TypeSystem::NoLanguage);
                 if (lang == TypeSystem::NoLanguage) {
                     m_error = QString("unsupported class attribute: '%1'").arg(languageAttribute);
@@ -863,7 +863,7 @@ bool Handler::startElement(const QString &, const QString &n,
                 QString modifier;
                 if (element->type == StackElement::Rename) {
                     modifier = "rename";
-                    QString renamed_to = attributes["to"];
+                    QString renamed_to = attributes[Attribute::To];
                     if (renamed_to.isEmpty()) {
                         m_error = "Rename modifier requires 'to' attribute";
                         return false;
@@ -874,7 +874,7 @@ bool Handler::startElement(const QString &, const QString &n,
                     else
                         mod->setRenamedTo(renamed_to);
                 } else {
-                    modifier = attributes["modifier"].toLower();
+                    modifier = attributes[Attribute::Modifier].toLower();
                 }
 
                 if (modifier.isEmpty()) {
@@ -912,15 +912,15 @@ bool Handler::startElement(const QString &, const QString &n,
                 break;
 
             case StackElement::ModifyField: {
-                QString name = attributes["name"];
+                QString name = attributes[Attribute::Name];
                 if (name.isEmpty())
                     break;
                 FieldModification fm;
                 fm.name = name;
                 fm.modifiers = 0;
 
-                QString read = attributes["read"];
-                QString write = attributes["write"];
+                QString read = attributes[Attribute::Read];
+                QString write = attributes[Attribute::Write];
 
                 if (read == "true") fm.modifiers |= FieldModification::Readable;
                 if (write == "true") fm.modifiers |= FieldModification::Writable;
@@ -934,7 +934,7 @@ bool Handler::startElement(const QString &, const QString &n,
                                                   ", was=%1").arg(topElement.type, 0, 16);
                     return false;
                 }
-                QString signature = attributes["signature"];
+                QString signature = attributes[Attribute::Signature];
 
                 // Perform global substitutions for QREAL/float/double to support ARM
                 if(Wrapper::isTargetPlatformArmCpu) /* ARM */
@@ -951,7 +951,7 @@ bool Handler::startElement(const QString &, const QString &n,
                 FunctionModification mod;
                 mod.signature = signature;
 
-                QString access = attributes["access"].toLower();
+                QString access = attributes[Attribute::Access].toLower();
                 if (!access.isEmpty()) {
                     if (access == QLatin1String("private"))
                         mod.modifiers |= Modification::Private;
@@ -969,11 +969,11 @@ bool Handler::startElement(const QString &, const QString &n,
                     }
                 }
 
-                if (convertBoolean(attributes["deprecated"], "deprecated", false)) {
+                if (convertBoolean(attributes[Attribute::Deprecated], "deprecated", false)) {
                     mod.modifiers |= Modification::Deprecated;
                 }
 
-                QString remove = attributes["remove"].toLower();
+                QString remove = attributes[Attribute::Remove].toLower();
                 if (!remove.isEmpty()) {
                     if (remove == QLatin1String("all"))
                         mod.removal = TypeSystem::All;
@@ -985,13 +985,13 @@ bool Handler::startElement(const QString &, const QString &n,
                     }
                 }
 
-                QString rename = attributes["rename"];
+                QString rename = attributes[Attribute::Rename];
                 if (!rename.isEmpty()) {
                     mod.renamedToName = rename;
                     mod.modifiers |= Modification::Rename;
                 }
 
-                QString association = attributes["associated-to"];
+                QString association = attributes[Attribute::AssociatedTo];
                 if (!association.isEmpty()) {
                     if(Wrapper::isTargetPlatformArmCpu) /* ARM */
                         association = association.replace(QLatin1String("%CPP_QREAL_type"), QLatin1String("float"));
@@ -1000,9 +1000,9 @@ bool Handler::startElement(const QString &, const QString &n,
                     mod.association = association;
                 }
 
-                mod.modifiers |= (convertBoolean(attributes["virtual-slot"], "virtual-slot", false) ? Modification::VirtualSlot : 0);
-                mod.modifiers |= (convertBoolean(attributes["allow-as-slot"], "allow-as-slot", false) ? Modification::AllowAsSlot : 0);
-                mod.modifiers |= (convertBoolean(attributes["private-signal"], "private-signal", false) ? Modification::PrivateSignal : 0);
+                mod.modifiers |= (convertBoolean(attributes[Attribute::VirtualSlot], "virtual-slot", false) ? Modification::VirtualSlot : 0);
+                mod.modifiers |= (convertBoolean(attributes[Attribute::AllowAsSlot], "allow-as-slot", false) ? Modification::AllowAsSlot : 0);
+                mod.modifiers |= (convertBoolean(attributes[Attribute::PrivateSignal], "private-signal", false) ? Modification::PrivateSignal : 0);
 
                 m_function_mods << mod;
             }
@@ -1013,20 +1013,20 @@ bool Handler::startElement(const QString &, const QString &n,
                     return false;
                 }
 
-                if (attributes["with"].isEmpty()) {
+                if (attributes[Attribute::With].isEmpty()) {
                     m_error = "Default expression replaced with empty string. Use remove-default-expression instead.";
                     return false;
                 }
 
-                m_function_mods.last().argument_mods.last().replaced_default_expression = attributes["with"];
+                m_function_mods.last().argument_mods.last().replaced_default_expression = attributes[Attribute::With];
                 break;
             case StackElement::RemoveDefaultExpression:
                 m_function_mods.last().argument_mods.last().removed_default_expression = true;
                 break;
             case StackElement::CustomMetaConstructor:
             case StackElement::CustomMetaDestructor: {
-                CustomFunction *func = new CustomFunction(attributes["name"]);
-                func->param_name = attributes["param-name"];
+                CustomFunction *func = new CustomFunction(attributes[Attribute::Name]);
+                func->param_name = attributes[Attribute::ParamName];
                 element->value.customFunction = func;
             }
             break;
@@ -1037,7 +1037,7 @@ bool Handler::startElement(const QString &, const QString &n,
                 }
 
                 ReferenceCount rc;
-                rc.threadSafe = convertBoolean(attributes["thread-safe"], "thread-safe", false);
+                rc.threadSafe = convertBoolean(attributes[Attribute::ThreadSafe], "thread-safe", false);
 
                 static QHash<QString, ReferenceCount::Action> actions;
                 if (actions.isEmpty()) {
@@ -1047,16 +1047,16 @@ bool Handler::startElement(const QString &, const QString &n,
                     actions["set"] = ReferenceCount::Set;
                     actions["ignore"] = ReferenceCount::Ignore;
                 }
-                rc.action = actions.value(attributes["action"].toLower(), ReferenceCount::Invalid);
+                rc.action = actions.value(attributes[Attribute::Action].toLower(), ReferenceCount::Invalid);
 
-                rc.variableName = attributes["variable-name"];
+                rc.variableName = attributes[Attribute::VariableName];
                 if (rc.action != ReferenceCount::Ignore && rc.variableName.isEmpty()) {
                     m_error = "variable-name attribute must be specified";
                     return false;
                 }
 
-                rc.declareVariable = attributes["declare-variable"];
-                rc.conditional = attributes["conditional"];
+                rc.declareVariable = attributes[Attribute::DeclareVariable];
+                rc.conditional = attributes[Attribute::Conditional];
 
                 static QHash<QString, int> accessRights;
                 if (accessRights.isEmpty()) {
@@ -1065,9 +1065,9 @@ bool Handler::startElement(const QString &, const QString &n,
                     accessRights["protected"] = ReferenceCount::Protected;
                     accessRights["friendly"] = ReferenceCount::Friendly;
                 }
-                rc.access = accessRights.value(attributes["access"].toLower(), 0);
+                rc.access = accessRights.value(attributes[Attribute::Access].toLower(), 0);
                 if (rc.access == 0) {
-                    m_error = "unrecognized access value: " + attributes["access"];
+                    m_error = "unrecognized access value: " + attributes[Attribute::Access];
                     return false;
                 }
 
@@ -1101,7 +1101,7 @@ bool Handler::startElement(const QString &, const QString &n,
                     languageNames["signal"] = TypeSystem::Signal;
                 }
 
-                QString className = attributes["class"].toLower();
+                QString className = attributes[Attribute::Class].toLower();
                 if (!languageNames.contains(className)) {
                     m_error = QString("Invalid class specifier: '%1'").arg(className);
                     return false;
@@ -1114,7 +1114,7 @@ bool Handler::startElement(const QString &, const QString &n,
                     positionNames["end"] = CodeSnip::End;
                 }
 
-                QString position = attributes["position"].toLower();
+                QString position = attributes[Attribute::Position].toLower();
                 if (!positionNames.contains(position)) {
                     m_error = QString("Invalid position: '%1'").arg(position);
                     return false;
@@ -1153,7 +1153,7 @@ bool Handler::startElement(const QString &, const QString &n,
                     return false;
                 }
 
-                QString location = attributes["location"].toLower();
+                QString location = attributes[Attribute::Location].toLower();
 
                 static QHash<QString, Include::IncludeType> locationNames;
                 if (locationNames.isEmpty()) {
@@ -1168,7 +1168,7 @@ bool Handler::startElement(const QString &, const QString &n,
                 }
 
                 Include::IncludeType loc = locationNames[location];
-                Include inc(loc, attributes["file-name"]);
+                Include inc(loc, attributes[Attribute::FileName]);
 
                 ComplexTypeEntry *ctype = static_cast<ComplexTypeEntry *>(element->entry);
                 if (topElement.type & StackElement::ComplexTypeEntryMask) {
@@ -1191,10 +1191,10 @@ bool Handler::startElement(const QString &, const QString &n,
             }
             break;
             case StackElement::Rejection: {
-                QString cls = attributes["class"];
-                QString function = attributes["function-name"];
-                QString field = attributes["field-name"];
-                QString enum_ = attributes["enum-name"];
+                QString cls = attributes[Attribute::Class];
+                QString function = attributes[Attribute::FunctionName];
+                QString field = attributes[Attribute::FieldName];
+                QString enum_ = attributes[Attribute::EnumName];
                 if (cls == "*" && function == "*" && field == "*" && enum_ == "*") {
                     m_error = "bad reject entry, neither 'class', 'function-name' nor "
                               "'field' specified";
@@ -1204,7 +1204,7 @@ bool Handler::startElement(const QString &, const QString &n,
             }
             break;
             case StackElement::Template:
-                element->value.templateEntry = new TemplateEntry(attributes["name"]);
+                element->value.templateEntry = new TemplateEntry(attributes[Attribute::Name]);
                 break;
             case StackElement::TemplateInstanceEnum:
                 if (!(topElement.type & StackElement::CodeSnipMask) &&
@@ -1215,14 +1215,14 @@ bool Handler::startElement(const QString &, const QString &n,
                     m_error = "Can only insert templates into code snippets, templates, custom-constructors, custom-destructors or conversion-rule.";
                     return false;
                 }
-                element->value.templateInstance = new TemplateInstance(attributes["name"]);
+                element->value.templateInstance = new TemplateInstance(attributes[Attribute::Name]);
                 break;
             case StackElement::Replace:
                 if (topElement.type != StackElement::TemplateInstanceEnum) {
                     m_error = "Can only insert replace rules into insert-template.";
                     return false;
                 }
-                element->parent->value.templateInstance->addReplaceRule(attributes["from"], attributes["to"]);
+                element->parent->value.templateInstance->addReplaceRule(attributes[Attribute::From], attributes[Attribute::To]);
                 break;
             case StackElement::ExtraIncludes: {
                 if ((topElement.type & StackElement::ComplexTypeEntryMask) == 0) {
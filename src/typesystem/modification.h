@@ -12,7 +12,8 @@ struct ArgumentModification {
             removed_default_expression(false),
             removed(false),
             no_null_pointers(false),
-            index(idx) {}
+            index(idx),
+            string_conversion(TypeSystem::DefaultStringConversion) {}
 
     //! Should the default expression be removed?
 uint removed_default_expression : 1;
@@ -45,6 +46,9 @@ uint reset_after_use : 1;
 
     //! Different conversion rules
     CodeSnipList conversion_rules;
+
+    //! How a QString argument or return value is converted to and from a jstring
+    TypeSystem::StringConversion string_conversion;
 };
 
 struct Modification {
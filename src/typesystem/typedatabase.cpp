@@ -6,14 +6,14 @@
 
 #include <qfile.h>
 #include <qfileinfo.h>
-#include <qxml.h>
 #include "handler.h"
+#include "typesystemloader.h"
 #include "../reporthandler.h"
 #include "../main.h"
 
 static void addRemoveFunctionToTemplates(TypeDatabase *db);
 
-TypeDatabase::TypeDatabase() : m_suppressWarnings(true), m_includeEclipseWarnings(false) {
+TypeDatabase::TypeDatabase() : m_suppressWarnings(true), m_includeEclipseWarnings(false), m_loader(0) {
     addType(new StringTypeEntry("QString"));
 
     StringTypeEntry *e = new StringTypeEntry("QLatin1String");
@@ -79,50 +79,56 @@ TypeDatabase *TypeDatabase::instance() {
     return db;
 }
 
-TypeEntry *TypeDatabase::findType(const QString &name) const {
-    QList<TypeEntry *> entries = findTypes(name);
-    foreach(TypeEntry *entry, entries) {
-        //qDebug()<<"findType()"<<entry;
-        if (entry != 0 &&
-                (!entry->isPrimitive() ||
-                 static_cast<PrimitiveTypeEntry *>(entry)->preferredTargetLangType())) {
-            return entry;
-        }
+void TypeDatabase::addType(TypeEntry *e) {
+    QString name = e->qualifiedCppName();
+    m_entries[name].append(e);
+
+    // findType() returns the first preferred entry for a name, so the
+    // cached entry only changes while there is none.
+    bool preferred = !e->isPrimitive()
+                     || static_cast<PrimitiveTypeEntry *>(e)->preferredTargetLangType();
+    if (m_preferred_entries.value(name) == 0)
+        m_preferred_entries[name] = preferred ? e : 0;
+
+    if (e->isPrimitive()) {
+        PrimitiveTypeEntry *pe = static_cast<PrimitiveTypeEntry *>(e);
+        if (pe->preferredConversion() && !m_target_lang_primitives.contains(pe->targetLangName()))
+            m_target_lang_primitives.insert(pe->targetLangName(), pe);
     }
-    return 0;
 }
 
-SingleTypeEntryHash TypeDatabase::entries() {
-    TypeEntryHash entries = allEntries();
+TypeEntry *TypeDatabase::findType(const QString &name) const {
+    return m_preferred_entries.value(name);
+}
 
-    SingleTypeEntryHash returned;
-    QList<QString> keys = entries.keys();
+void TypeDatabase::addSuppressedWarning(const QString &s) {
+    m_suppressedWarnings.append(s);
 
-    foreach(QString key, keys) {
-        returned[key] = findType(key);
-    }
+    QString warning(QString(s).replace("\\*", "&place_holder_for_asterisk;"));
+
+    QStringList segs = warning.split("*", QString::SkipEmptyParts);
+    if (segs.size() == 0)
+        return;
+
+    for (int i = 0; i < segs.size(); ++i)
+        segs[i].replace("&place_holder_for_asterisk;", "*");
 
-    return returned;
+    m_suppressedWarningPatterns.append(segs);
 }
 
 bool TypeDatabase::isSuppressedWarning(const QString &s) {
     if (!m_suppressWarnings)
         return false;
 
-    foreach(const QString &_warning, m_suppressedWarnings) {
-        QString warning(QString(_warning).replace("\\*", "&place_holder_for_asterisk;"));
-
-        QStringList segs = warning.split("*", QString::SkipEmptyParts);
-        if (segs.size() == 0)
-            continue ;
+    for (int p = 0; p < m_suppressedWarningPatterns.size(); ++p) {
+        const QStringList &segs = m_suppressedWarningPatterns.at(p);
 
         int i = 0;
-        int pos = s.indexOf(QString(segs.at(i++)).replace("&place_holder_for_asterisk;", "*"));
-        //qDebug() << "s == " << s << ", warning == " << segs;
+        int pos = s.indexOf(segs.at(i++));
         while (pos != -1) {
             if (i == segs.size())
                 return true;
-            pos = s.indexOf(QString(segs.at(i++)).replace("&place_holder_for_asterisk;", "*"), pos);
+            pos = s.indexOf(segs.at(i++), pos);
         }
     }
 
@@ -175,18 +181,59 @@ bool TypeDatabase::parseFile(const QString &filename, const QStringList &importI
     QFile file(filepath);
     Q_ASSERT(file.exists());
     qDebug() << "Parsing file: " << filename;
-    QXmlInputSource source(&file);
+
+    // The outermost call owns the loader. Typesystems loaded by this
+    // file are read on worker threads while this one is being handled,
+    // and are handled in declaration order when their element is reached.
+    bool ownsLoader = m_loader == 0;
+    if (ownsLoader) {
+        m_loader = new TypesystemLoader;
+
+        if (!m_precompiled_typesystem.isEmpty()) {
+            if (m_loader->loadPrecompiled(m_precompiled_typesystem))
+                qDebug() << "Using precompiled typesystem: " << m_precompiled_typesystem;
+            else
+                qDebug() << "Not using precompiled typesystem: " << m_precompiled_typesystem;
+        }
+    }
+
+    TypesystemDocument *document = m_loader->take(filepath);
+    foreach(const QString &import, document->imports()) {
+        QString importPath = resolveFilePath(import, 0, importInputDirectoryList);
+        if (!importPath.isNull())
+            m_loader->prefetch(importPath);
+    }
 
     int count = m_entries.size();
 
-    QXmlSimpleReader reader;
     Handler handler(this, generate);
     handler.setImportInputDirectoryList(importInputDirectoryList);
+    handler.setTypesystemLoader(m_loader);
+
+    bool ok = document->replay(&handler);
+    delete document;
+
+    if (ownsLoader) {
+        qDebug() << QString::fromLatin1("Imported files: %1 read, %2 reused")
+                    .arg(m_loader->importsRead())
+                    .arg(m_loader->importsReused());
+
+        foreach(const QString &used, m_loader->usedFiles()) {
+            QString path = QFileInfo(used).absoluteFilePath();
+            if (!m_input_files.contains(path))
+                m_input_files << path;
+        }
 
-    reader.setContentHandler(&handler);
-    reader.setErrorHandler(&handler);
+        if (ok && !m_precompile_typesystem_target.isEmpty()) {
+            if (!m_loader->savePrecompiled(m_precompile_typesystem_target)) {
+                qWarning() << "Cannot write precompiled typesystem: " << m_precompile_typesystem_target;
+                ok = false;
+            }
+        }
+        delete m_loader;
+        m_loader = 0;
+    }
 
-    bool ok = reader.parse(&source, false);
     int newCount = m_entries.size();
 
     QString string = QString::fromLatin1("Parsed: '%1', %2 new entries")
@@ -212,17 +259,7 @@ ContainerTypeEntry *TypeDatabase::findContainerType(const QString &name) {
 }
 
 PrimitiveTypeEntry *TypeDatabase::findTargetLangPrimitiveType(const QString &java_name) {
-    foreach(QList<TypeEntry *> entries, m_entries.values()) {
-        foreach(TypeEntry *e, entries) {
-            if (e && e->isPrimitive()) {
-                PrimitiveTypeEntry *pe = static_cast<PrimitiveTypeEntry *>(e);
-                if (pe->targetLangName() == java_name && pe->preferredConversion())
-                    return pe;
-            }
-        }
-    }
-
-    return 0;
+    return m_target_lang_primitives.value(java_name);
 }
 
 IncludeList TypeDatabase::extraIncludes(const QString &className) {
@@ -242,45 +279,40 @@ void TypeDatabase::addRejection(const QString &class_name, const QString &functi
     r.enum_name = enum_name;
 
     m_rejections << r;
+
+    if (function_name == "*" && field_name == "*" && enum_name == "*")
+        m_rejected_classes.insert(class_name);
+    m_rejected_functions[function_name].insert(class_name);
+    m_rejected_fields[field_name].insert(class_name);
+    m_rejected_enums[enum_name].insert(class_name);
+}
+
+static bool is_rejected_in(const QHash<QString, QSet<QString> > &rejections,
+                           const QString &class_name, const QString &name) {
+    QHash<QString, QSet<QString> >::const_iterator it = rejections.constFind(name);
+    if (it == rejections.constEnd())
+        return false;
+    return it.value().contains(class_name) || it.value().contains(QLatin1String("*"));
 }
 
 bool TypeDatabase::isClassRejected(const QString &class_name) {
     if (!m_rebuild_classes.isEmpty())
         return !m_rebuild_classes.contains(class_name);
 
-    foreach(const TypeRejection &r, m_rejections)
-    if (r.class_name == class_name && r.function_name == "*" && r.field_name == "*" && r.enum_name == "*") {
-        return true;
-    }
-    return false;
+    return m_rejected_classes.contains(class_name);
 }
 
 bool TypeDatabase::isEnumRejected(const QString &class_name, const QString &enum_name) {
-    foreach(const TypeRejection &r, m_rejections) {
-        if (r.enum_name == enum_name
-                && (r.class_name == class_name || r.class_name == "*")) {
-            return true;
-        }
-    }
-
-    return false;
+    return is_rejected_in(m_rejected_enums, class_name, enum_name);
 }
 
 bool TypeDatabase::isFunctionRejected(const QString &class_name, const QString &function_name) {
-    foreach(const TypeRejection &r, m_rejections)
-    if (r.function_name == function_name &&
-            (r.class_name == class_name || r.class_name == "*"))
-        return true;
-    return false;
+    return is_rejected_in(m_rejected_functions, class_name, function_name);
 }
 
 
 bool TypeDatabase::isFieldRejected(const QString &class_name, const QString &field_name) {
-    foreach(const TypeRejection &r, m_rejections)
-    if (r.field_name == field_name &&
-            (r.class_name == class_name || r.class_name == "*"))
-        return true;
-    return false;
+    return is_rejected_in(m_rejected_fields, class_name, field_name);
 }
 
 FlagsTypeEntry *TypeDatabase::findFlagsType(const QString &name) const {
@@ -2,11 +2,15 @@
 #ifndef TYPEDATABASE_H_
 #define TYPEDATABASE_H_
 
+#include <QHash>
 #include <QList>
+#include <QSet>
 #include <qstringlist.h>
 
 #include "typeentry.h"
 
+class TypesystemLoader;
+
 class TypeDatabase {
     public:
         TypeDatabase();
@@ -32,7 +36,9 @@ class TypeDatabase {
             return m_entries;
         }
 
-        SingleTypeEntryHash entries();
+        SingleTypeEntryHash entries() const {
+            return m_preferred_entries;
+        }
 
         PrimitiveTypeEntry *findTargetLangPrimitiveType(const QString &java_name);
 
@@ -43,9 +49,7 @@ class TypeDatabase {
         bool isFieldRejected(const QString &class_name, const QString &field_name);
         bool isEnumRejected(const QString &class_name, const QString &enum_name);
 
-        void addType(TypeEntry *e) {
-            m_entries[e->qualifiedCppName()].append(e);
-        }
+        void addType(TypeEntry *e);
 
         SingleTypeEntryHash flagsEntries() const {
             return m_flags_entries;
@@ -74,14 +78,12 @@ class TypeDatabase {
         void setSuppressWarnings(bool on) {
             m_suppressWarnings = on;
         }
-        void addSuppressedWarning(const QString &s) {
-            m_suppressedWarnings.append(s);
-        }
+        void addSuppressedWarning(const QString &s);
 
         bool isSuppressedWarning(const QString &s);
 
         void setRebuildClasses(const QStringList &cls) {
-            m_rebuild_classes = cls;
+            m_rebuild_classes = cls.toSet();
         }
 
         static QString globalNamespaceClassName(const TypeEntry *te);
@@ -91,6 +93,21 @@ class TypeDatabase {
 
         bool parseFile(const QString &filename, const QStringList &importInputDirectoryList, bool generate = true, bool optional = false);
 
+        void setPrecompiledTypesystem(const QString &fileName) {
+            m_precompiled_typesystem = fileName;
+        }
+        void setPrecompileTypesystemTarget(const QString &fileName) {
+            m_precompile_typesystem_target = fileName;
+        }
+
+        /**
+         * Absolute paths of every typesystem and imported file read by
+         * parseFile().
+         */
+        QStringList inputFiles() const {
+            return m_input_files;
+        }
+
     private:
     uint m_suppressWarnings :
         1;
@@ -99,13 +116,34 @@ class TypeDatabase {
     uint m_reserved :
         30;
 
+        TypesystemLoader *m_loader;
+        QString m_precompiled_typesystem;
+        QString m_precompile_typesystem_target;
+        QStringList m_input_files;
+
         TypeEntryHash m_entries;
+        // Secondary indexes kept up to date by addType(): the entry
+        // findType() returns for each C++ name, and the preferred
+        // primitive entry for each target language name.
+        SingleTypeEntryHash m_preferred_entries;
+        QHash<QString, PrimitiveTypeEntry *> m_target_lang_primitives;
         SingleTypeEntryHash m_flags_entries;
         TemplateEntryHash m_templates;
         QStringList m_suppressedWarnings;
+        // Suppressed warnings split on unescaped '*' into the segments
+        // that have to occur in order in a matching warning.
+        QList<QStringList> m_suppressedWarningPatterns;
 
         QList<TypeRejection> m_rejections;
-        QStringList m_rebuild_classes;
+        QSet<QString> m_rebuild_classes;
+
+        // Rejections indexed by kind: fully rejected class names, and
+        // function, field and enum names mapped to the classes they are
+        // rejected in ("*" for all classes).
+        QSet<QString> m_rejected_classes;
+        QHash<QString, QSet<QString> > m_rejected_functions;
+        QHash<QString, QSet<QString> > m_rejected_fields;
+        QHash<QString, QSet<QString> > m_rejected_enums;
 };
 
 #endif
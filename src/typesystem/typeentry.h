@@ -18,6 +18,7 @@ extern QString strings_jobject;
 class InterfaceTypeEntry;
 class ObjectTypeEntry;
 class AbstractMetaType;
+class TextBuffer;
 
 class EnumTypeEntry;
 class FlagsTypeEntry;
@@ -320,7 +321,8 @@ class PrimitiveTypeEntry : public TypeEntry {
     public:
         PrimitiveTypeEntry(const QString &name)
                 : TypeEntry(name, PrimitiveType),
-                m_preferred_java_type(true) {
+                m_preferred_java_type(true),
+                m_bulk_containers(false) {
             setPreferredConversion(true);
         }
 
@@ -353,10 +355,23 @@ class PrimitiveTypeEntry : public TypeEntry {
             m_preferred_java_type = b;
         }
 
+        /**
+         * Containers of this type (QList<int>, QVector<double>...) are
+         * passed to Java as primitive arrays and copied in one go
+         * rather than boxed element by element into a collection.
+         */
+        bool bulkContainers() const {
+            return m_bulk_containers;
+        }
+        void setBulkContainers(bool b) {
+            m_bulk_containers = b;
+        }
+
     private:
         QString m_java_name;
         QString m_jni_name;
         bool m_preferred_java_type;
+        bool m_bulk_containers;
 };
 
 class EnumTypeEntry : public TypeEntry {
@@ -792,13 +807,13 @@ class CustomTypeEntry : public ComplexTypeEntry {
     public:
         CustomTypeEntry(const QString &name) : ComplexTypeEntry(name, CustomType) { }
 
-        virtual void generateCppJavaToQt(QTextStream &s,
+        virtual void generateCppJavaToQt(TextBuffer &s,
                                          const AbstractMetaType *java_type,
                                          const QString &env_name,
                                          const QString &qt_name,
                                          const QString &java_name) const = 0;
 
-        virtual void generateCppQtToJava(QTextStream &s,
+        virtual void generateCppQtToJava(TextBuffer &s,
                                          const AbstractMetaType *java_type,
                                          const QString &env_name,
                                          const QString &qt_name,
@@ -817,8 +832,20 @@ class ValueTypeEntry : public ComplexTypeEntry {
             return true;
         }
 
+        // Names of the C++ getters whose values are packed into a jlong
+        // when the type is returned from native code, see flatten=""
+        QStringList flattenedFields() const {
+            return m_flattened_fields;
+        }
+        void setFlattenedFields(const QStringList &fields) {
+            m_flattened_fields = fields;
+        }
+
     protected:
         ValueTypeEntry(const QString &name, Type t) : ComplexTypeEntry(name, t) { }
+
+    private:
+        QStringList m_flattened_fields;
 };
 
 class StringTypeEntry : public ValueTypeEntry {
@@ -77,7 +77,7 @@ QString fixCppTypeName(const QString &name) {
     return name;
 }
 
-QString formattedCodeHelper(QTextStream &s, Indentor &indentor, QStringList &lines) {
+QString formattedCodeHelper(TextBuffer &s, Indentor &indentor, QStringList &lines) {
     bool multilineComment = false;
     bool lastEmpty = true;
     QString lastLine;
@@ -147,8 +147,8 @@ QString formattedCodeHelper(QTextStream &s, Indentor &indentor, QStringList &lin
 }
 
 
-QTextStream &CodeSnip::formattedCode(QTextStream &s, Indentor &indentor) const {
-    QStringList lst(code().split("\n"));
+TextBuffer &CodeSnip::formattedCode(TextBuffer &s, Indentor &indentor) const {
+    QStringList lst(lines());
     while (!lst.isEmpty()) {
         QString tmp = formattedCodeHelper(s, indentor, lst);
         if (!tmp.isNull()) {
@@ -159,14 +159,62 @@ QTextStream &CodeSnip::formattedCode(QTextStream &s, Indentor &indentor) const {
     return s;
 }
 
+/*!
+ * Replaces all occurrences of the keys in \a rules in one pass over
+ * \a code. Where several keys match at the same position the longest
+ * one wins, and replaced text is never scanned again.
+ */
+static QString replace_all(const QString &code, const QHash<QString, QString> &rules) {
+    if (rules.isEmpty())
+        return code;
+
+    QHash<QChar, QStringList> keys_by_first_char;
+    for (QHash<QString, QString>::const_iterator it = rules.constBegin(); it != rules.constEnd(); ++it) {
+        if (it.key().isEmpty())
+            continue;
+        QStringList &keys = keys_by_first_char[it.key().at(0)];
+        int pos = 0;
+        while (pos < keys.size() && keys.at(pos).size() >= it.key().size())
+            ++pos;
+        keys.insert(pos, it.key());
+    }
+
+    QString result;
+    result.reserve(code.size());
+
+    int i = 0;
+    while (i < code.size()) {
+        QHash<QChar, QStringList>::const_iterator candidates = keys_by_first_char.constFind(code.at(i));
+        bool matched = false;
+        if (candidates != keys_by_first_char.constEnd()) {
+            const QStringList &keys = candidates.value();
+            for (int k = 0; k < keys.size(); ++k) {
+                const QString &key = keys.at(k);
+                if (code.midRef(i, key.size()) == key) {
+                    result += rules.value(key);
+                    i += key.size();
+                    matched = true;
+                    break;
+                }
+            }
+        }
+        if (!matched)
+            result += code.at(i++);
+    }
+
+    return result;
+}
+
 QString TemplateInstance::expandCode() const {
+    if (m_expanded_valid)
+        return m_expanded;
+
     TemplateEntry *templateEntry = TypeDatabase::instance()->findTemplate(m_name);
     if (templateEntry) {
-        QString res = templateEntry->code();
-        foreach(QString key, replaceRules.keys()) {
-            res.replace(key, replaceRules[key]);
-        }
-        return "// TEMPLATE - " + m_name + " - START" + res + "// TEMPLATE - " + m_name + " - END";
+        QString res = replace_all(templateEntry->code(), replaceRules);
+        m_expanded = "// TEMPLATE - " + m_name + " - START" + res + "// TEMPLATE - " + m_name + " - END";
+        m_expanded_valid = true;
+        return m_expanded;
     } else {
         ReportHandler::warning("insert-template referring to non-existing template '" + m_name + "'");
     }
@@ -47,10 +47,11 @@ typedef QHash<QString, TemplateEntry *> TemplateEntryHash;
 class TemplateInstance {
     public:
         TemplateInstance(const QString &name)
-                : m_name(name) {}
+                : m_name(name), m_expanded_valid(false) {}
 
         void addReplaceRule(const QString &name, const QString &value) {
             replaceRules[name] = value;
+            m_expanded_valid = false;
         }
 
         QString expandCode() const;
@@ -62,6 +63,10 @@ class TemplateInstance {
     private:
         const QString m_name;
         QHash<QString, QString> replaceRules;
+
+        // The expansion is computed on first use and then reused.
+        mutable QString m_expanded;
+        mutable bool m_expanded_valid;
 };
 
 namespace TypeSystem {
@@ -98,6 +103,12 @@ namespace TypeSystem {
         TargetLangOwnership,
         CppOwnership
     };
+
+    enum StringConversion {
+        DefaultStringConversion,    //!< qtjambi_to_qstring() / qtjambi_from_qstring()
+        DirectStringConversion,     //!< GetStringRegion() / NewString() in place
+        AsciiStringConversion       //!< As direct, short ASCII strings go out through NewStringUTF()
+    };
 };
 
 struct Include {
@@ -0,0 +1,386 @@
+
+#include "typesystemloader.h"
+#include "handler.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QTextStream>
+#include <QXmlStreamReader>
+#include <QtConcurrentRun>
+
+bool TypesystemDocument::read(const QString &filepath) {
+    QFile file(filepath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_error = QString("Could not open file: '%1'").arg(filepath);
+        return false;
+    }
+
+    QXmlStreamReader reader(file.readAll());
+    file.close();
+
+    while (!reader.atEnd()) {
+        switch (reader.readNext()) {
+            case QXmlStreamReader::StartElement: {
+                TypesystemEvent event(TypesystemEvent::StartElement, reader.lineNumber(), reader.columnNumber());
+
+                // Tag names repeat a lot, share one string per name.
+                QString name = reader.name().toString();
+                QString &interned = m_names[name];
+                if (interned.isNull())
+                    interned = name.toLower();
+                event.name = interned;
+                event.attributes = reader.attributes();
+                internNames(&event);
+
+                if (event.name == QLatin1String("load-typesystem"))
+                    m_imports << event.attributes.value("name").toString();
+
+                m_events << event;
+            }
+            break;
+            case QXmlStreamReader::EndElement: {
+                TypesystemEvent event(TypesystemEvent::EndElement, reader.lineNumber(), reader.columnNumber());
+                event.name = m_names.value(reader.name().toString());
+                internNames(&event);
+                m_events << event;
+            }
+            break;
+            case QXmlStreamReader::Characters: {
+                TypesystemEvent event(TypesystemEvent::Characters, reader.lineNumber(), reader.columnNumber());
+                event.text = reader.text().toString();
+                m_events << event;
+            }
+            break;
+            default:
+                break;
+        }
+    }
+
+    if (reader.hasError()) {
+        m_error = reader.errorString();
+        m_error_line = reader.lineNumber();
+        m_error_column = reader.columnNumber();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Resolves the tag name and attribute names of \a event, looking each
+ * distinct name up once per document.
+ */
+void TypesystemDocument::internNames(TypesystemEvent *event) {
+    QHash<QString, StackElement::ElementType>::const_iterator type = m_element_types.constFind(event->name);
+    if (type == m_element_types.constEnd())
+        type = m_element_types.insert(event->name, elementTypeFromTag(event->name));
+    event->elementType = type.value();
+
+    event->attributeIds.clear();
+    event->attributeIds.reserve(event->attributes.size());
+    foreach(const QXmlStreamAttribute &attribute, event->attributes) {
+        QString name = attribute.name().toString();
+        QHash<QString, Attribute::Id>::const_iterator id = m_attribute_ids.constFind(name);
+        if (id == m_attribute_ids.constEnd())
+            id = m_attribute_ids.insert(name, Attribute::fromName(name.toLower()));
+        event->attributeIds << id.value();
+    }
+}
+
+bool TypesystemDocument::replay(Handler *handler) const {
+    for (int i = 0; i < m_events.size(); ++i) {
+        const TypesystemEvent &event = m_events.at(i);
+
+        bool ok = true;
+        switch (event.type) {
+            case TypesystemEvent::StartElement:
+                ok = handler->startElement(event);
+                break;
+            case TypesystemEvent::EndElement:
+                ok = handler->endElement(event);
+                break;
+            case TypesystemEvent::Characters:
+                ok = handler->characters(event.text);
+                break;
+        }
+
+        if (!ok) {
+            qWarning("Fatal error: line=%d, column=%d, message=%s\n",
+                     int(event.lineNumber), int(event.columnNumber), qPrintable(handler->errorString()));
+            return false;
+        }
+    }
+
+    if (!m_error.isEmpty()) {
+        qWarning("Fatal error: line=%d, column=%d, message=%s\n",
+                 int(m_error_line), int(m_error_column), qPrintable(m_error));
+        return false;
+    }
+
+    return true;
+}
+
+void TypesystemDocument::save(QDataStream &out) const {
+    out << qint32(m_events.size());
+    foreach(const TypesystemEvent &event, m_events) {
+        out << qint32(event.type) << event.name << event.text
+            << event.lineNumber << event.columnNumber;
+
+        out << qint32(event.attributes.size());
+        foreach(const QXmlStreamAttribute &attribute, event.attributes)
+            out << attribute.qualifiedName().toString() << attribute.value().toString();
+    }
+
+    out << m_imports << m_error << m_error_line << m_error_column;
+}
+
+void TypesystemDocument::load(QDataStream &in) {
+    qint32 eventCount;
+    in >> eventCount;
+    for (int i = 0; i < eventCount && in.status() == QDataStream::Ok; ++i) {
+        qint32 type;
+        QString name;
+        QString text;
+        qint64 line;
+        qint64 column;
+        in >> type >> name >> text >> line >> column;
+
+        TypesystemEvent event(TypesystemEvent::Type(type), line, column);
+        event.name = name;
+        event.text = text;
+
+        qint32 attributeCount;
+        in >> attributeCount;
+        for (int j = 0; j < attributeCount && in.status() == QDataStream::Ok; ++j) {
+            QString qualifiedName;
+            QString value;
+            in >> qualifiedName >> value;
+            event.attributes.append(qualifiedName, value);
+        }
+
+        if (event.type != TypesystemEvent::Characters)
+            internNames(&event);
+        m_events << event;
+    }
+
+    in >> m_imports >> m_error >> m_error_line >> m_error_column;
+}
+
+static TypesystemDocument *read_typesystem_document(const QString &filepath) {
+    TypesystemDocument *document = new TypesystemDocument;
+    document->read(filepath);
+    return document;
+}
+
+int ImportedFile::findLine(const QString &marker, int from) {
+    QHash<QString, QList<int> >::iterator it = m_marker_lines.find(marker);
+    if (it == m_marker_lines.end()) {
+        QList<int> lines;
+        for (int i = 0; i < m_lines.size(); ++i) {
+            if (m_lines.at(i).contains(marker))
+                lines << i;
+        }
+        it = m_marker_lines.insert(marker, lines);
+    }
+
+    foreach(int line, it.value()) {
+        if (line >= from)
+            return line;
+    }
+    return -1;
+}
+
+/**
+ * Returns the lines after the first line containing \a quoteFrom, up to
+ * the next line containing \a quoteTo. An empty \a quoteFrom quotes from
+ * the start of the file.
+ */
+QString ImportedFile::snippet(const QString &quoteFrom, const QString &quoteTo,
+                              bool *foundFrom, bool *foundTo) {
+    int start = 0;
+    if (!quoteFrom.isEmpty()) {
+        int line = findLine(quoteFrom, 0);
+        *foundFrom = line >= 0;
+        if (line < 0) {
+            *foundTo = quoteTo.isEmpty();
+            return QString();
+        }
+        start = line + 1;
+    } else {
+        *foundFrom = true;
+    }
+
+    int end = findLine(quoteTo, start);
+    *foundTo = end >= 0 || quoteTo.isEmpty();
+    if (end < 0)
+        end = m_lines.size();
+
+    QPair<QString, QString> key(quoteFrom, quoteTo);
+    QHash<QPair<QString, QString>, QString>::const_iterator cached = m_snippets.constFind(key);
+    if (cached != m_snippets.constEnd())
+        return cached.value();
+
+    QString code;
+    for (int i = start; i < end; ++i) {
+        code += m_lines.at(i);
+        code += QLatin1Char('\n');
+    }
+    m_snippets.insert(key, code);
+    return code;
+}
+
+TypesystemLoader::~TypesystemLoader() {
+    foreach(QFuture<TypesystemDocument *> future, m_pending)
+        delete future.result();
+    qDeleteAll(m_imported_files);
+}
+
+/**
+ * Returns the file at \a filepath split into lines, reading it on first
+ * use, or 0 if it can not be opened.
+ */
+ImportedFile *TypesystemLoader::importedFile(const QString &filepath) {
+    ImportedFile *imported = m_imported_files.value(filepath);
+    if (imported) {
+        if (!m_used_files.contains(filepath))
+            m_used_files << filepath;
+        ++m_imports_reused;
+        return imported;
+    }
+
+    QFile file(filepath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return 0;
+
+    imported = new ImportedFile;
+    QTextStream in(&file);
+    while (!in.atEnd())
+        imported->m_lines << in.readLine();
+
+    ++m_imports_read;
+    m_imported_files.insert(filepath, imported);
+    m_used_files << filepath;
+    return imported;
+}
+
+void TypesystemLoader::prefetch(const QString &filepath) {
+    if (!m_pending.contains(filepath) && !m_documents.contains(filepath))
+        m_pending.insert(filepath, QtConcurrent::run(read_typesystem_document, filepath));
+}
+
+TypesystemDocument *TypesystemLoader::take(const QString &filepath) {
+    if (!m_used_files.contains(filepath))
+        m_used_files << filepath;
+
+    if (m_documents.contains(filepath))
+        return new TypesystemDocument(m_documents.value(filepath));
+
+    TypesystemDocument *document;
+    if (m_pending.contains(filepath))
+        document = m_pending.take(filepath).result();
+    else
+        document = read_typesystem_document(filepath);
+
+    m_documents.insert(filepath, *document);
+    return document;
+}
+
+static const quint32 PRECOMPILED_TYPESYSTEM_MAGIC = 0x51544753; // "QTGS"
+static const quint32 PRECOMPILED_TYPESYSTEM_VERSION = 1;
+
+static QByteArray source_file_hash(const QString &filepath) {
+    QFile file(filepath);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return QCryptographicHash::hash(file.readAll(), QCryptographicHash::Sha1);
+}
+
+/**
+ * Loads a precompiled typesystem written by savePrecompiled(). Returns
+ * false, leaving the loader unchanged, if the file can not be read or
+ * any of the typesystem or imported files it was built from changed.
+ */
+bool TypesystemLoader::loadPrecompiled(const QString &fileName) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_5);
+
+    quint32 magic;
+    quint32 version;
+    in >> magic >> version;
+    if (magic != PRECOMPILED_TYPESYSTEM_MAGIC || version != PRECOMPILED_TYPESYSTEM_VERSION)
+        return false;
+
+    QHash<QString, QByteArray> sources;
+    in >> sources;
+    for (QHash<QString, QByteArray>::const_iterator it = sources.constBegin(); it != sources.constEnd(); ++it) {
+        if (source_file_hash(it.key()) != it.value()) {
+            qDebug() << "Precompiled typesystem" << fileName << "is out of date:" << it.key() << "changed";
+            return false;
+        }
+    }
+
+    QHash<QString, TypesystemDocument> documents;
+    qint32 documentCount;
+    in >> documentCount;
+    for (int i = 0; i < documentCount && in.status() == QDataStream::Ok; ++i) {
+        QString filepath;
+        in >> filepath;
+        documents[filepath].load(in);
+    }
+
+    QHash<QString, QStringList> importedFiles;
+    in >> importedFiles;
+
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    m_documents = documents;
+    for (QHash<QString, QStringList>::const_iterator it = importedFiles.constBegin(); it != importedFiles.constEnd(); ++it) {
+        ImportedFile *imported = new ImportedFile;
+        imported->m_lines = it.value();
+        delete m_imported_files.value(it.key());
+        m_imported_files.insert(it.key(), imported);
+    }
+
+    return true;
+}
+
+/**
+ * Writes every typesystem document and imported file seen by this
+ * loader to \a fileName, with a SHA-1 hash of each source file.
+ */
+bool TypesystemLoader::savePrecompiled(const QString &fileName) const {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << PRECOMPILED_TYPESYSTEM_MAGIC << PRECOMPILED_TYPESYSTEM_VERSION;
+
+    QHash<QString, QByteArray> sources;
+    foreach(const QString &filepath, m_documents.keys())
+        sources.insert(filepath, source_file_hash(filepath));
+    foreach(const QString &filepath, m_imported_files.keys())
+        sources.insert(filepath, source_file_hash(filepath));
+    out << sources;
+
+    out << qint32(m_documents.size());
+    for (QHash<QString, TypesystemDocument>::const_iterator it = m_documents.constBegin(); it != m_documents.constEnd(); ++it) {
+        out << it.key();
+        it.value().save(out);
+    }
+
+    QHash<QString, QStringList> importedFiles;
+    for (QHash<QString, ImportedFile *>::const_iterator it = m_imported_files.constBegin(); it != m_imported_files.constEnd(); ++it)
+        importedFiles.insert(it.key(), it.value()->m_lines);
+    out << importedFiles;
+
+    return out.status() == QDataStream::Ok;
+}
@@ -0,0 +1,146 @@
+
+#ifndef TYPESYSTEMLOADER_H_
+#define TYPESYSTEMLOADER_H_
+
+#include <QFuture>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QStringList>
+#include <QVector>
+#include <QXmlStreamAttributes>
+
+#include "typesystemnames.h"
+
+class Handler;
+class QDataStream;
+
+/**
+ * One element, end tag or piece of character data read from a
+ * typesystem file. Tag names are lower case, as the Handler expects,
+ * and are resolved to an element type together with the attribute
+ * names, so the Handler does not compare names as strings.
+ */
+struct TypesystemEvent {
+    enum Type {
+        StartElement,
+        EndElement,
+        Characters
+    };
+
+    TypesystemEvent(Type t, qint64 line, qint64 column)
+            : type(t), elementType(StackElement::None), lineNumber(line), columnNumber(column) { }
+
+    Type type;
+    QString name;
+    StackElement::ElementType elementType;
+    QXmlStreamAttributes attributes;
+    // Parallel to attributes.
+    QVector<Attribute::Id> attributeIds;
+    QString text;
+    qint64 lineNumber;
+    qint64 columnNumber;
+};
+
+/**
+ * A typesystem file read with QXmlStreamReader into a flat list of
+ * events. Reading does not touch the TypeDatabase, so documents can be
+ * read on worker threads and replayed through a Handler afterwards.
+ */
+class TypesystemDocument {
+    public:
+        TypesystemDocument() : m_error_line(0), m_error_column(0) { }
+
+        bool read(const QString &filepath);
+        bool replay(Handler *handler) const;
+
+        void save(QDataStream &out) const;
+        void load(QDataStream &in);
+
+        QStringList imports() const {
+            return m_imports;
+        }
+
+    private:
+        void internNames(TypesystemEvent *event);
+
+        QList<TypesystemEvent> m_events;
+        QStringList m_imports;
+        QHash<QString, QString> m_names;
+        QHash<QString, StackElement::ElementType> m_element_types;
+        QHash<QString, Attribute::Id> m_attribute_ids;
+
+        QString m_error;
+        qint64 m_error_line;
+        qint64 m_error_column;
+};
+
+/**
+ * A file quoted by <import-file>, split into lines once. Lines that
+ * contain a given quote marker are looked up once per marker.
+ */
+class ImportedFile {
+    public:
+        QString snippet(const QString &quoteFrom, const QString &quoteTo,
+                        bool *foundFrom, bool *foundTo);
+
+    private:
+        friend class TypesystemLoader;
+
+        int findLine(const QString &marker, int from);
+
+        QStringList m_lines;
+        QHash<QString, QList<int> > m_marker_lines;
+        QHash<QPair<QString, QString>, QString> m_snippets;
+};
+
+/**
+ * Reads typesystem files ahead of time on a thread pool. Files are
+ * identified by their resolved path; take() waits for a prefetched
+ * document or reads it synchronously when it was not prefetched.
+ *
+ * All documents and imported files of a load can be saved to a
+ * precompiled typesystem file together with a hash of each source.
+ * Loading that file again makes take() and importedFile() serve its
+ * contents without touching the XML, as long as no source changed.
+ */
+class TypesystemLoader {
+    public:
+        TypesystemLoader() : m_imports_read(0), m_imports_reused(0) { }
+        ~TypesystemLoader();
+
+        void prefetch(const QString &filepath);
+        TypesystemDocument *take(const QString &filepath);
+
+        bool loadPrecompiled(const QString &fileName);
+        bool savePrecompiled(const QString &fileName) const;
+
+        ImportedFile *importedFile(const QString &filepath);
+
+        int importsRead() const {
+            return m_imports_read;
+        }
+        int importsReused() const {
+            return m_imports_reused;
+        }
+
+        /**
+         * Every typesystem and imported file handed out by this loader,
+         * in the order they were first used.
+         */
+        QStringList usedFiles() const {
+            return m_used_files;
+        }
+
+    private:
+        QHash<QString, QFuture<TypesystemDocument *> > m_pending;
+        // Every document handed out by take() or loaded from a
+        // precompiled typesystem, by resolved path.
+        QHash<QString, TypesystemDocument> m_documents;
+        QHash<QString, ImportedFile *> m_imported_files;
+        QStringList m_used_files;
+        int m_imports_read;
+        int m_imports_reused;
+};
+
+#endif
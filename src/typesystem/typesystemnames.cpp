@@ -0,0 +1,141 @@
+
+#include "typesystemnames.h"
+
+#include <QByteArray>
+
+#include <algorithm>
+
+// Indexed by Attribute::Id, so it must stay sorted like the enum.
+static const char *const attribute_names[Attribute::Count] = {
+    "access",
+    "action",
+    "allow-as-slot",
+    "associated-to",
+    "bulk-containers",
+    "class",
+    "conditional",
+    "declare-variable",
+    "default-superclass",
+    "default-value",
+    "delete-in-main-thread",
+    "deprecated",
+    "enum-name",
+    "expense-cost",
+    "expense-limit",
+    "extensible",
+    "field-name",
+    "file-name",
+    "flags",
+    "flatten",
+    "force-abstract",
+    "force-integer",
+    "from",
+    "function-name",
+    "generate",
+    "generic-class",
+    "implements",
+    "index",
+    "invalidate-after-use",
+    "java-name",
+    "jni-name",
+    "location",
+    "lower-bound",
+    "meta-name",
+    "modified-type",
+    "modifier",
+    "name",
+    "optional",
+    "owner",
+    "package",
+    "param-name",
+    "polymorphic-base",
+    "polymorphic-id-expression",
+    "position",
+    "preferred-conversion",
+    "preferred-java-type",
+    "private-signal",
+    "read",
+    "remove",
+    "rename",
+    "replace-value",
+    "signature",
+    "string-conversion",
+    "target-type",
+    "text",
+    "thread-safe",
+    "to",
+    "upper-bound",
+    "variable-name",
+    "virtual-slot",
+    "with",
+    "write",
+};
+
+struct TagName {
+    const char *name;
+    StackElement::ElementType type;
+};
+
+// Sorted by name for the binary search in elementTypeFromTag().
+static const TagName tag_names[] = {
+    { "access", StackElement::Access },
+    { "argument-map", StackElement::ArgumentMap },
+    { "conversion-rule", StackElement::ConversionRule },
+    { "custom-constructor", StackElement::CustomMetaConstructor },
+    { "custom-destructor", StackElement::CustomMetaDestructor },
+    { "define-ownership", StackElement::DefineOwnership },
+    { "enum-type", StackElement::EnumTypeEntry },
+    { "extra-includes", StackElement::ExtraIncludes },
+    { "include", StackElement::Include },
+    { "inject-code", StackElement::InjectCode },
+    { "insert-template", StackElement::TemplateInstanceEnum },
+    { "interface-type", StackElement::InterfaceTypeEntry },
+    { "load-typesystem", StackElement::LoadTypesystem },
+    { "modify-argument", StackElement::ModifyArgument },
+    { "modify-field", StackElement::ModifyField },
+    { "modify-function", StackElement::ModifyFunction },
+    { "namespace-type", StackElement::NamespaceTypeEntry },
+    { "no-null-pointer", StackElement::NoNullPointers },
+    { "object-type", StackElement::ObjectTypeEntry },
+    { "primitive-type", StackElement::PrimitiveTypeEntry },
+    { "reference-count", StackElement::ReferenceCount },
+    { "reject-enum-value", StackElement::RejectEnumValue },
+    { "rejection", StackElement::Rejection },
+    { "remove", StackElement::Removal },
+    { "remove-argument", StackElement::RemoveArgument },
+    { "remove-default-expression", StackElement::RemoveDefaultExpression },
+    { "rename", StackElement::Rename },
+    { "replace", StackElement::Replace },
+    { "replace-default-expression", StackElement::ReplaceDefaultExpression },
+    { "replace-type", StackElement::ReplaceType },
+    { "suppress-warning", StackElement::SuppressedWarning },
+    { "template", StackElement::Template },
+    { "typesystem", StackElement::Root },
+    { "value-type", StackElement::ValueTypeEntry },
+};
+
+static bool attribute_name_less(const char *name, const QByteArray &key) {
+    return qstrcmp(name, key.constData()) < 0;
+}
+
+static bool tag_name_less(const TagName &tag, const QByteArray &key) {
+    return qstrcmp(tag.name, key.constData()) < 0;
+}
+
+Attribute::Id Attribute::fromName(const QString &name) {
+    QByteArray key = name.toLatin1();
+    const char *const *end = attribute_names + Count;
+    const char *const *it = std::lower_bound(attribute_names, end, key, attribute_name_less);
+    if (it == end || qstrcmp(*it, key.constData()) != 0)
+        return Unknown;
+    return Id(it - attribute_names);
+}
+
+StackElement::ElementType elementTypeFromTag(const QString &tagName) {
+    QByteArray key = tagName.toLatin1();
+    const TagName *end = tag_names + sizeof(tag_names) / sizeof(tag_names[0]);
+    const TagName *it = std::lower_bound(tag_names, end, key, tag_name_less);
+    if (it == end || qstrcmp(it->name, key.constData()) != 0)
+        return StackElement::None;
+    return it->type;
+}
@@ -0,0 +1,131 @@
+
+#ifndef TYPESYSTEMNAMES_H_
+#define TYPESYSTEMNAMES_H_
+
+#include <QString>
+#include "stackelement.h"
+
+/**
+ * The attributes typesystem elements accept, in alphabetical order of
+ * their names. TypesystemDocument maps each attribute name to one of
+ * these once when a file is read.
+ */
+class Attribute {
+    public:
+        enum Id {
+            Access,
+            Action,
+            AllowAsSlot,
+            AssociatedTo,
+            BulkContainers,
+            Class,
+            Conditional,
+            DeclareVariable,
+            DefaultSuperclass,
+            DefaultValue,
+            DeleteInMainThread,
+            Deprecated,
+            EnumName,
+            ExpenseCost,
+            ExpenseLimit,
+            Extensible,
+            FieldName,
+            FileName,
+            Flags,
+            Flatten,
+            ForceAbstract,
+            ForceInteger,
+            From,
+            FunctionName,
+            Generate,
+            GenericClass,
+            Implements,
+            Index,
+            InvalidateAfterUse,
+            JavaName,
+            JniName,
+            Location,
+            LowerBound,
+            MetaName,
+            ModifiedType,
+            Modifier,
+            Name,
+            Optional,
+            Owner,
+            Package,
+            ParamName,
+            PolymorphicBase,
+            PolymorphicIdExpression,
+            Position,
+            PreferredConversion,
+            PreferredJavaType,
+            PrivateSignal,
+            Read,
+            Remove,
+            Rename,
+            ReplaceValue,
+            Signature,
+            StringConversion,
+            TargetType,
+            Text,
+            ThreadSafe,
+            To,
+            UpperBound,
+            VariableName,
+            VirtualSlot,
+            With,
+            Write,
+            Count,
+            Unknown = Count
+        };
+
+        /**
+         * Returns the id of the lower case attribute \a name, or
+         * Unknown when no element accepts it.
+         */
+        static Id fromName(const QString &name);
+};
+
+/**
+ * The values of the attributes one element accepts, indexed by
+ * Attribute::Id. Like the QHash it replaces, assigning to an attribute
+ * marks it as accepted.
+ */
+class AttributeValues {
+    public:
+        AttributeValues() : m_count(0) {
+            for (int i = 0; i < Attribute::Count; ++i)
+                m_accepted[i] = false;
+        }
+
+        QString &operator[](Attribute::Id id) {
+            Q_ASSERT(id < Attribute::Count);
+            if (!m_accepted[id]) {
+                m_accepted[id] = true;
+                ++m_count;
+            }
+            return m_values[id];
+        }
+
+        bool contains(Attribute::Id id) const {
+            return id < Attribute::Count && m_accepted[id];
+        }
+
+        int count() const {
+            return m_count;
+        }
+
+    private:
+        QString m_values[Attribute::Count];
+        bool m_accepted[Attribute::Count];
+        int m_count;
+};
+
+/**
+ * Returns the element type for the lower case \a tagName, or
+ * StackElement::None for <import-file> and for tags the Handler does
+ * not know.
+ */
+StackElement::ElementType elementTypeFromTag(const QString &tagName);
+
+#endif
@@ -1,7 +1,7 @@
-
 #include "wrapper.h"
 #include "reporthandler.h"
 #include "fileout.h"
+#include "depfile.h"
 #include "typesystem/typedatabase.h"
 #include "main.h"
 #include "asttoxml.h"
@@ -9,6 +9,8 @@
 #include "util.h"
 
 QString Wrapper::include_directory = QString();
+QString Wrapper::pp_snapshot_file = QString();
+int Wrapper::pp_snapshot_lines = 0;
 
 bool Wrapper::isTargetPlatformArmCpu = false;
 
@@ -61,6 +63,12 @@ void Wrapper::handleArguments() {
         FileOut::diff = true;
     }
 
+    if (args.contains("precompile-typesystem"))
+        TypeDatabase::instance()->setPrecompileTypesystemTarget(args.value("precompile-typesystem"));
+
+    if (args.contains("precompiled-typesystem"))
+        TypeDatabase::instance()->setPrecompiledTypesystem(args.value("precompiled-typesystem"));
+
     if (args.contains("rebuild-only")) {
         QStringList classes = args.value("rebuild-only").split(",", QString::SkipEmptyParts);
         TypeDatabase::instance()->setRebuildClasses(classes);
@@ -69,6 +77,18 @@ void Wrapper::handleArguments() {
     if (args.contains("qt-include-directory"))
         include_directory = args.value("qt-include-directory");
 
+    if (args.contains("pp-snapshot"))
+        pp_snapshot_file = args.value("pp-snapshot");
+
+    if (args.contains("pp-snapshot-lines")) {
+        bool ok;
+        pp_snapshot_lines = args.value("pp-snapshot-lines").toInt(&ok);
+        if (!ok || pp_snapshot_lines < 0) {
+            printf("Invalid value for --pp-snapshot-lines: '%s'\n", qPrintable(args.value("pp-snapshot-lines")));
+            displayHelp(gs);
+        }
+    }
+
     if (args.contains("include-paths")) {        // split on path
         QString arg = args.value("include-paths");
 #if defined(Q_OS_WIN32)
@@ -210,16 +230,28 @@ void Wrapper::assignVariables() {
 }
 
 int Wrapper::runJambiGenerator() {
+    if (args.contains("skip-if-unchanged")
+            && DepFile::isUpToDate(args.value("skip-if-unchanged"), GeneratorSet::argumentsKey(args))) {
+        printf("Inputs unchanged since the last run, nothing to generate.\n");
+        return 0;
+    }
+
     printf("Running the Qt Generator. Please wait while source files are being generated...\n");
 
     //parse the type system file
     if (!TypeDatabase::instance()->parseFile(typesystemFileName, inputDirectoryList))
         qFatal("Cannot parse file: '%s'", qPrintable(typesystemFileName));
 
+    if (args.contains("precompile-typesystem")) {
+        printf("Wrote precompiled typesystem: '%s'\n", qPrintable(args.value("precompile-typesystem")));
+        return 0;
+    }
+
     //removing file here for theoretical case of wanting to parse two master include files here
     QFile::remove(pp_file);
     //preprocess using master include, preprocessed file and command line given include paths, if any
-    if (!Preprocess::preprocess(fileName, pp_file, args.value("phonon-include"), includePathsList, inputDirectoryList, debugCppMode)) {
+    QStringList includedFiles;
+    if (!Preprocess::preprocess(fileName, pp_file, args.value("phonon-include"), includePathsList, inputDirectoryList, debugCppMode, &includedFiles)) {
         fprintf(stderr, "Preprocessor failed on file: '%s'\n", qPrintable(fileName));
         return 1;
     }
@@ -239,7 +271,30 @@ int Wrapper::runJambiGenerator() {
         return 0;
     }
 
+    FileOut::setManifestFile(QDir(gs->outDir).absoluteFilePath(".qtjambi-generator.manifest"));
     printf("%s\n", qPrintable(gs->generate()));
+    int failedWrites = FileOut::finishWrites();
+
+    QStringList inputs = TypeDatabase::instance()->inputFiles() + includedFiles;
+
+    if (args.contains("depfile")) {
+        QString target = args.contains("depfile-target") ? args.value("depfile-target") : pp_file;
+        DepFile::writeDepfile(args.value("depfile"), target, inputs);
+    }
+
+    if (args.contains("skip-if-unchanged")) {
+        // The stamp only checks that outputs exist, so it must not vouch
+        // for files whose write failed and that still hold old contents.
+        if (failedWrites == 0)
+            DepFile::writeStamp(args.value("skip-if-unchanged"), GeneratorSet::argumentsKey(args), inputs, FileOut::outputFiles);
+        else
+            QFile::remove(args.value("skip-if-unchanged"));
+    }
+
+    if (failedWrites != 0) {
+        fprintf(stderr, "Failed to write %d generated file(s)\n", failedWrites);
+        return 1;
+    }
 
     printf("Done, %d warnings (%d known issues)\n", ReportHandler::warningCount(),
            ReportHandler::suppressedCount());
@@ -271,6 +326,13 @@ void Wrapper::displayHelp(GeneratorSet* generatorSet) {
            "  --print-stdout                            \n"
            "  --qt-include-directory=[dir]              \n"
            "  --qtjambi-debug-tools                     \n"
+           "  --precompile-typesystem=[file]            \n"
+           "  --precompiled-typesystem=[file]           \n"
+           "  --pp-snapshot=[file]                      \n"
+           "  --pp-snapshot-lines=[n]                   \n"
+           "  --depfile=[file]                          \n"
+           "  --depfile-target=[name]                   \n"
+           "  --skip-if-unchanged=[file]                \n"
            "  --preproc-stage1                          \n"
            "  --preproc-stage2                          \n"
            "  --target-platform-arm-cpu                 \n"
@@ -45,6 +45,8 @@ class Wrapper {
         Wrapper(int argc, char *argv[]);
 
         static QString include_directory;
+        static QString pp_snapshot_file;
+        static int pp_snapshot_lines;
         static bool qtjambi_debug_tools;
         static bool isTargetPlatformArmCpu;
         void setDefineUndefineStage(int stage) { defineUndefineStageCurrent = stage; }